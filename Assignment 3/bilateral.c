@@ -0,0 +1,108 @@
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "bilateral.h"
+
+int bilateral_init(BILATERAL *b, int radius, double sigma_s, double sigma_r)
+{
+	int dy,dx,d,k=0;
+	if(radius < 1 || radius > MAX_BILATERAL_RADIUS)
+		return 0;
+	b->radius = radius;
+	for(dy=-radius;dy<=radius;dy++)
+		for(dx=-radius;dx<=radius;dx++)
+			b->space[k++] = (unsigned short)(255.0 * exp(-(dx*dx + dy*dy) / (2.0 * sigma_s * sigma_s)) + 0.5);
+	for(d=0;d<256;d++)
+		b->range[d] = (unsigned short)(255.0 * exp(-(d*d) / (2.0 * sigma_r * sigma_r)) + 0.5);
+	return 1;
+}
+
+static int clamp(int v, int n)
+{
+	return v < 0 ? 0 : v >= n ? n - 1 : v;
+}
+
+/* one pixel with clamped neighbours, for the frame border */
+static unsigned char bilateral_pixel(const BILATERAL *b, const unsigned char *src, int i, int j, int H, int W)
+{
+	int r = b->radius, dy, dx, k = 0;
+	int c = src[(size_t)i * W + j];
+	unsigned int sw = 0, sp = 0;
+	for(dy=-r;dy<=r;dy++){
+		const unsigned char *row = src + (size_t)clamp(i+dy,H) * W;
+		for(dx=-r;dx<=r;dx++){
+			int p = row[clamp(j+dx,W)];
+			unsigned int w = b->space[k++] * b->range[p > c ? p - c : c - p];
+			sw += w;
+			sp += w * p;
+		}
+	}
+	return (unsigned char)((sp + sw / 2) / sw);
+}
+
+static void bilateral_row(const BILATERAL *b, const unsigned char *src, unsigned char *d, int i, int H, int W)
+{
+	int r = b->radius, j = 0;
+
+	if(i >= r && i + r < H){
+		for(;j<r && j<W;j++)
+			d[j] = bilateral_pixel(b, src, i, j, H, W);
+#ifdef __SSE2__
+		/* 8 pixels at a time, all of their windows inside the frame.
+		 * Weights are products of two 8-bit values, so 16-bit lanes hold
+		 * them exactly; the weighted pixel sums need 32 bits. */
+		for(;j+8+r<=W;j+=8){
+			const __m128i z = _mm_setzero_si128();
+			__m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + (size_t)i * W + j)), z);
+			__m128i wlo = z, whi = z, plo = z, phi = z;
+			unsigned short dd[8], rw[8];
+			unsigned int sw[8], sp[8];
+			int dy, dx, k = 0, l;
+
+			for(dy=-r;dy<=r;dy++){
+				const unsigned char *row = src + (size_t)(i + dy) * W + j;
+				for(dx=-r;dx<=r;dx++){
+					__m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(row + dx)), z);
+					__m128i w, pl, ph;
+					_mm_storeu_si128((__m128i *)dd, _mm_or_si128(_mm_subs_epu16(p,c), _mm_subs_epu16(c,p)));
+					for(l=0;l<8;l++)
+						rw[l] = b->range[dd[l]];
+					w = _mm_mullo_epi16(_mm_loadu_si128((const __m128i *)rw), _mm_set1_epi16((short)b->space[k++]));
+					wlo = _mm_add_epi32(wlo, _mm_unpacklo_epi16(w,z));
+					whi = _mm_add_epi32(whi, _mm_unpackhi_epi16(w,z));
+					pl = _mm_mullo_epi16(w,p);
+					ph = _mm_mulhi_epu16(w,p);
+					plo = _mm_add_epi32(plo, _mm_unpacklo_epi16(pl,ph));
+					phi = _mm_add_epi32(phi, _mm_unpackhi_epi16(pl,ph));
+				}
+			}
+			_mm_storeu_si128((__m128i *)sw, wlo);
+			_mm_storeu_si128((__m128i *)(sw + 4), whi);
+			_mm_storeu_si128((__m128i *)sp, plo);
+			_mm_storeu_si128((__m128i *)(sp + 4), phi);
+			for(l=0;l<8;l++)
+				d[j+l] = (unsigned char)((sp[l] + sw[l] / 2) / sw[l]);
+		}
+#endif
+	}
+	for(;j<W;j++)
+		d[j] = bilateral_pixel(b, src, i, j, H, W);
+}
+
+void bilateral_plane(const BILATERAL *b, const unsigned char *src, unsigned char *dst, int H, int W)
+{
+	int i;
+	#pragma omp parallel for schedule(static)
+	for(i=0;i<H;i++)
+		bilateral_row(b, src, dst + (size_t)i * W, i, H, W);
+}
+
+void bilateral_image(const BILATERAL *b, const IMAGE *src, IMAGE *dst)
+{
+	int k;
+	for(k=0;k<NUM_PLANES;k++)
+		if(src->plane[k]!=NULL)
+			bilateral_plane(b, src->plane[k], dst->plane[k], src->H, src->W);
+}
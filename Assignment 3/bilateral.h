@@ -0,0 +1,27 @@
+/* Edge-preserving bilateral filter on 8-bit planes.
+ * A neighbour at offset (dy,dx) with value difference d to the centre is
+ * weighted space[dy][dx] * range[d]. Both tables are filled once, in 8-bit
+ * fixed point, so no exp() is evaluated per pixel. Neighbours outside the
+ * frame are taken from the nearest border pixel.
+ */
+
+#ifndef BILATERAL_H
+#define BILATERAL_H
+
+#include "image.h"
+
+#define MAX_BILATERAL_RADIUS 7
+#define BILATERAL_SIGMA_R 30.0	/* default range sigma, in grey levels */
+
+typedef struct BILATERAL{
+	int radius;
+	unsigned short space[(2*MAX_BILATERAL_RADIUS+1)*(2*MAX_BILATERAL_RADIUS+1)];
+	unsigned short range[256];
+}BILATERAL;
+
+/* returns 0 when radius is out of 1..MAX_BILATERAL_RADIUS */
+int bilateral_init(BILATERAL *b, int radius, double sigma_s, double sigma_r);
+void bilateral_plane(const BILATERAL *b, const unsigned char *src, unsigned char *dst, int H, int W);
+void bilateral_image(const BILATERAL *b, const IMAGE *src, IMAGE *dst);
+
+#endif
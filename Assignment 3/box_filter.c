@@ -0,0 +1,114 @@
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "box_filter.h"
+
+int roi_clip(const ROI *roi, int H, int W, ROI *r)
+{
+	int x0,y0,x1,y1;
+	if(roi==NULL || roi->w<=0 || roi->h<=0){
+		r->x = r->y = 0;
+		r->w = W;
+		r->h = H;
+		return H>0 && W>0;
+	}
+	/* roi and r may be the same struct */
+	x0 = roi->x < 0 ? 0 : roi->x;
+	y0 = roi->y < 0 ? 0 : roi->y;
+	x1 = roi->x + roi->w > W ? W : roi->x + roi->w;
+	y1 = roi->y + roi->h > H ? H : roi->y + roi->h;
+	r->x = x0;
+	r->y = y0;
+	r->w = x1 - x0;
+	r->h = y1 - y0;
+	return r->w>0 && r->h>0;
+}
+
+void roi_halo(const ROI *r, int H, int W, ROI *halo)
+{
+	int x1 = r->x + r->w + 1 > W ? W : r->x + r->w + 1;
+	int y1 = r->y + r->h + 1 > H ? H : r->y + r->h + 1;
+	halo->x = r->x > 0 ? r->x - 1 : 0;
+	halo->y = r->y > 0 ? r->y - 1 : 0;
+	halo->w = x1 - halo->x;
+	halo->h = y1 - halo->y;
+}
+
+/* inner pixels j0 <= j < j1 of one row, the caller keeps 1 <= j0 and j1 <= W-1 */
+static void lowpass_row(const unsigned char *up, const unsigned char *mid, const unsigned char *dn,
+		unsigned char *d, int j0, int j1)
+{
+	int j = j0;
+#ifdef __SSE2__
+	/* 16 pixels at a time in 16-bit lanes, the sum is at most 9*255.
+	 * mulhi by ceil(65536/9) is an exact floor(x/9) for that range. */
+	const __m128i z = _mm_setzero_si128();
+	const __m128i k9 = _mm_set1_epi16(7282);
+	for(;j+16<=j1;j+=16){
+		__m128i lo, hi, v;
+		__m128i a = _mm_loadu_si128((const __m128i *)(up+j-1));
+		__m128i b = _mm_loadu_si128((const __m128i *)(up+j));
+		__m128i c = _mm_loadu_si128((const __m128i *)(up+j+1));
+		lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a,z), _mm_unpacklo_epi8(b,z)), _mm_unpacklo_epi8(c,z));
+		hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a,z), _mm_unpackhi_epi8(b,z)), _mm_unpackhi_epi8(c,z));
+		a = _mm_loadu_si128((const __m128i *)(mid+j-1));
+		b = _mm_loadu_si128((const __m128i *)(mid+j));
+		c = _mm_loadu_si128((const __m128i *)(mid+j+1));
+		lo = _mm_add_epi16(lo, _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a,z), _mm_unpacklo_epi8(b,z)), _mm_unpacklo_epi8(c,z)));
+		hi = _mm_add_epi16(hi, _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a,z), _mm_unpackhi_epi8(b,z)), _mm_unpackhi_epi8(c,z)));
+		a = _mm_loadu_si128((const __m128i *)(dn+j-1));
+		b = _mm_loadu_si128((const __m128i *)(dn+j));
+		c = _mm_loadu_si128((const __m128i *)(dn+j+1));
+		lo = _mm_add_epi16(lo, _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a,z), _mm_unpacklo_epi8(b,z)), _mm_unpacklo_epi8(c,z)));
+		hi = _mm_add_epi16(hi, _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a,z), _mm_unpackhi_epi8(b,z)), _mm_unpackhi_epi8(c,z)));
+		v = _mm_packus_epi16(_mm_mulhi_epu16(lo,k9), _mm_mulhi_epu16(hi,k9));
+		_mm_storeu_si128((__m128i *)(d+j), v);
+	}
+#endif
+	for(;j<j1;j++)
+		d[j] = (up[j-1]+up[j]+up[j+1]+
+				mid[j-1]+mid[j]+mid[j+1]+
+				dn[j-1]+dn[j]+dn[j+1])/9;
+}
+
+void lowpass_plane(const unsigned char *src, unsigned char *dst, int H, int W, const ROI *roi)
+{
+	ROI r;
+	int i;
+
+	if(!roi_clip(roi,H,W,&r))
+		return;
+
+	/* rows are independent, each thread takes a band of them */
+	#pragma omp parallel for schedule(static)
+	for(i=r.y;i<r.y+r.h;i++){
+		const unsigned char *s = src + (size_t)i * W;
+		unsigned char *d = dst + (size_t)i * W;
+		int j0 = r.x, j1 = r.x + r.w;
+
+		if(i==0 || i==H-1){
+			memcpy(d+j0, s+j0, j1-j0);
+			continue;
+		}
+		if(j0==0){
+			d[0] = s[0];
+			j0 = 1;
+		}
+		if(j1==W){
+			d[W-1] = s[W-1];
+			j1 = W-1;
+		}
+		if(j0<j1)
+			lowpass_row(s-W, s, s+W, d, j0, j1);
+	}
+}
+
+void lowpass_image(const IMAGE *src, IMAGE *dst, const ROI *roi)
+{
+	int k;
+	for(k=0;k<NUM_PLANES;k++)
+		if(src->plane[k]!=NULL)
+			lowpass_plane(src->plane[k], dst->plane[k], src->H, src->W, roi);
+}
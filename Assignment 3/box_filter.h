@@ -0,0 +1,27 @@
+/* 3x3 box (low-pass) filter on 8-bit planes.
+ * Same convention as the fabric in top_level_27.vhdl: pixels on the frame
+ * border are copied through, inner pixels get the truncated sum / 9.
+ */
+
+#ifndef BOX_FILTER_H
+#define BOX_FILTER_H
+
+#include "image.h"
+
+typedef struct ROI{
+	int x, y;                       /* first column and row */
+	int w, h;                       /* width and height, 0 means whole frame */
+}ROI;
+
+/* clip roi to an H x W frame, NULL or an empty roi selects the whole frame.
+ * returns 0 when nothing of the frame is left */
+int roi_clip(const ROI *roi, int H, int W, ROI *r);
+/* r grown by the one-pixel halo the filter reads, clipped to the frame */
+void roi_halo(const ROI *r, int H, int W, ROI *halo);
+
+/* filter the pixels of roi from src into dst. Pixels of dst outside the
+ * region are not touched, so work is proportional to the region area. */
+void lowpass_plane(const unsigned char *src, unsigned char *dst, int H, int W, const ROI *roi);
+void lowpass_image(const IMAGE *src, IMAGE *dst, const ROI *roi);
+
+#endif
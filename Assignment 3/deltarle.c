@@ -0,0 +1,90 @@
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "deltarle.h"
+
+/* difference of byte i to the one before */
+#define DELTA(src,i) ((unsigned char)((src)[i] - ((i) ? (src)[(i)-1] : 0)))
+
+/* differences from i on equal to the one at i, at most max */
+static size_t run_length(const unsigned char *src, size_t i, size_t n, size_t max)
+{
+	unsigned char d = DELTA(src, i);
+	size_t j = i + 1;
+
+	if(n - i < max)
+		max = n - i;
+#ifdef __SSE2__
+	{
+		const __m128i dd = _mm_set1_epi8((char)d);
+		/* j >= 1, so src[j-1] is always there */
+		for(;j+16<=i+max;j+=16){
+			__m128i x = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)(src+j)),
+				_mm_loadu_si128((const __m128i *)(src+j-1)));
+			int m = _mm_movemask_epi8(_mm_cmpeq_epi8(x, dd)) ^ 0xffff;
+			if(m){
+				while(!(m & 1)){
+					m >>= 1;
+					j++;
+				}
+				return j - i;
+			}
+		}
+	}
+#endif
+	while(j < i + max && DELTA(src, j) == d)
+		j++;
+	return j - i;
+}
+
+/* control byte and differences of src[i..i+len) */
+static size_t literal(const unsigned char *src, size_t i, size_t len, unsigned char *dst)
+{
+	size_t j = 0;
+
+	dst[0] = (unsigned char)(len - 1);
+	dst++;
+	if(i == 0 && len > 0){
+		dst[0] = src[0];
+		j = 1;
+	}
+#ifdef __SSE2__
+	for(;j+16<=len;j+=16)
+		_mm_storeu_si128((__m128i *)(dst+j), _mm_sub_epi8(_mm_loadu_si128((const __m128i *)(src+i+j)),
+			_mm_loadu_si128((const __m128i *)(src+i+j-1))));
+#endif
+	for(;j<len;j++)
+		dst[j] = DELTA(src, i+j);
+	return len + 1;
+}
+
+size_t drle_encode(const unsigned char *src, size_t n, unsigned char *dst)
+{
+	size_t i = 0, lit = 0, o = 0;
+
+	while(i < n){
+		size_t r;
+		/* a run pays off from three equal differences */
+		if(i + 2 < n && DELTA(src, i+1) == DELTA(src, i) && DELTA(src, i+2) == DELTA(src, i)
+				&& (r = run_length(src, i, n, DRLE_MAX_RUN)) >= 3){
+			/* the last byte goes as a literal, see deltarle.h */
+			if(i + r == n)
+				r--;
+			if(lit < i)
+				o += literal(src, lit, i - lit, dst + o);
+			dst[o++] = (unsigned char)(0x80 | (r - 2));
+			dst[o++] = DELTA(src, i);
+			i += r;
+			lit = i;
+		}
+		else if(++i - lit == DRLE_MAX_LIT){
+			o += literal(src, lit, i - lit, dst + o);
+			lit = i;
+		}
+	}
+	if(lit < n)
+		o += literal(src, lit, n - lit, dst + o);
+	return o;
+}
@@ -0,0 +1,27 @@
+/* Delta plus run-length coding of phase uploads, decoded by the fabric on
+ * its way from h2fData to the BRAMs, and by emu_decode in the emulator. Each byte is sent as its difference
+ * to the previous one of the channel (0 before the first), and the
+ * differences are grouped by a control byte c:
+ *   c < 0x80   the next c+1 bytes are differences
+ *   c >= 0x80  the next byte is a difference that repeats (c & 0x7f) + 2
+ *              times, runs of equal pixels or of a constant slope
+ * Smooth images shrink a lot, noise grows by one byte in 128. A stream
+ * never ends in a run: the fabric writes the repeats while it holds the
+ * host off, but takes the channel of the next command regardless, which
+ * would cut a last run short.
+ */
+
+#ifndef DELTARLE_H
+#define DELTARLE_H
+
+#include <stddef.h>
+
+#define DRLE_MAX_LIT 128
+#define DRLE_MAX_RUN 129
+/* bytes n bytes take in the worst case */
+#define DRLE_BOUND(n) ((n) + ((n) + DRLE_MAX_LIT - 1) / DRLE_MAX_LIT)
+
+/* encode n bytes to dst, at least DRLE_BOUND(n) bytes, returns its length */
+size_t drle_encode(const unsigned char *src, size_t n, unsigned char *dst);
+
+#endif
@@ -0,0 +1,128 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "dirty_tiles.h"
+#include "box_filter.h"
+
+int tile_cache_init(TILE_CACHE *c, int H, int W, int tile)
+{
+	memset(c, 0, sizeof(*c));
+	c->H = H;
+	c->W = W;
+	c->tile = tile > 0 ? tile : TILE_SIZE;
+	c->tiles_x = (W + c->tile - 1) / c->tile;
+	c->tiles_y = (H + c->tile - 1) / c->tile;
+	c->changed = (unsigned char *)calloc((size_t)c->tiles_x * c->tiles_y, 1);
+	c->dirty = (unsigned char *)calloc((size_t)c->tiles_x * c->tiles_y, 1);
+	if(c->changed==NULL || c->dirty==NULL || !image_alloc(&c->prev,H,W) || !image_alloc(&c->out,H,W)){
+		tile_cache_free(c);
+		return 0;
+	}
+	return 1;
+}
+
+void tile_cache_free(TILE_CACHE *c)
+{
+	image_free(&c->prev);
+	image_free(&c->out);
+	free(c->changed);
+	free(c->dirty);
+	c->changed = c->dirty = NULL;
+	c->valid = 0;
+}
+
+static void tile_roi(const TILE_CACHE *c, int t, ROI *r)
+{
+	r->x = (t % c->tiles_x) * c->tile;
+	r->y = (t / c->tiles_x) * c->tile;
+	r->w = r->x + c->tile > c->W ? c->W - r->x : c->tile;
+	r->h = r->y + c->tile > c->H ? c->H - r->y : c->tile;
+}
+
+static int tile_differs(const TILE_CACHE *c, const IMAGE *frame, const ROI *r)
+{
+	int k,i;
+	for(k=0;k<NUM_PLANES;k++)
+		for(i=r->y;i<r->y+r->h && frame->plane[k]!=NULL;i++){
+			size_t o = (size_t)i * c->W + r->x;
+			if(memcmp(frame->plane[k] + o, c->prev.plane[k] + o, r->w))
+				return 1;
+		}
+	return 0;
+}
+
+static void tile_store(TILE_CACHE *c, const IMAGE *frame, const ROI *r)
+{
+	int k,i;
+	for(k=0;k<NUM_PLANES;k++)
+		for(i=r->y;i<r->y+r->h && frame->plane[k]!=NULL;i++){
+			size_t o = (size_t)i * c->W + r->x;
+			memcpy(c->prev.plane[k] + o, frame->plane[k] + o, r->w);
+		}
+}
+
+int tile_cache_lowpass(TILE_CACHE *c, const IMAGE *frame)
+{
+	int n = c->tiles_x * c->tiles_y;
+	int t, nchanged = 0, ndirty = 0;
+
+	if(frame->H != c->H || frame->W != c->W)
+		return -1;
+
+	/* 1. which tiles changed since the previous frame */
+	#pragma omp parallel for schedule(dynamic) reduction(+:nchanged)
+	for(t=0;t<n;t++){
+		ROI r;
+		tile_roi(c, t, &r);
+		c->changed[t] = !c->valid || tile_differs(c, frame, &r);
+		nchanged += c->changed[t];
+	}
+
+	/* 2. a change reaches the output of the neighbouring tiles too */
+	for(t=0;t<n;t++){
+		int tx = t % c->tiles_x, ty = t / c->tiles_x, dx, dy, d = 0;
+		for(dy=-1;dy<=1 && !d;dy++)
+			for(dx=-1;dx<=1 && !d;dx++){
+				int x = tx + dx, y = ty + dy;
+				if(x>=0 && x<c->tiles_x && y>=0 && y<c->tiles_y)
+					d = c->changed[y * c->tiles_x + x];
+			}
+		c->dirty[t] = d;
+		ndirty += d;
+	}
+
+	/* 3. filter only the dirty tiles, the rest of out is reused */
+	#pragma omp parallel for schedule(dynamic)
+	for(t=0;t<n;t++){
+		ROI r;
+		if(!c->dirty[t])
+			continue;
+		tile_roi(c, t, &r);
+		lowpass_image(frame, &c->out, &r);
+	}
+
+	/* 4. remember the new input of the changed tiles */
+	#pragma omp parallel for schedule(dynamic)
+	for(t=0;t<n;t++){
+		ROI r;
+		if(!c->changed[t])
+			continue;
+		tile_roi(c, t, &r);
+		tile_store(c, frame, &r);
+	}
+
+	c->valid = 1;
+	c->frames++;
+	c->tiles_seen += n;
+	c->tiles_changed += nchanged;
+	c->tiles_recomputed += ndirty;
+	return ndirty;
+}
+
+void tile_cache_stats(const TILE_CACHE *c, FILE *f)
+{
+	double saved = c->tiles_seen ? 100.0 * (c->tiles_seen - c->tiles_recomputed) / c->tiles_seen : 0.0;
+	fprintf(f, "\ntiles: %d x %d of %d pixels, %ld frames\n", c->tiles_x, c->tiles_y, c->tile, c->frames);
+	fprintf(f, "tiles changed %ld, recomputed %ld of %ld (%.1f%% of the work saved)\n",
+			c->tiles_changed, c->tiles_recomputed, c->tiles_seen, saved);
+}
@@ -0,0 +1,39 @@
+/* Incremental low-pass for frame sequences.
+ * The frame is cut into square tiles. A tile is filtered again only when
+ * it, or one of its eight neighbours (the filter reads a one-pixel halo),
+ * differs from the previous frame; all other tiles keep the cached output.
+ */
+
+#ifndef DIRTY_TILES_H
+#define DIRTY_TILES_H
+
+#include <stdio.h>
+#include "image.h"
+
+#define TILE_SIZE 32
+
+typedef struct TILE_CACHE{
+	int H, W;
+	int tile;                       /* tile edge in pixels */
+	int tiles_x, tiles_y;
+	int valid;                      /* prev and out hold a frame */
+	IMAGE prev;                     /* previous input frame */
+	IMAGE out;                      /* low-pass of the previous frame */
+	unsigned char *changed;         /* per tile, input differs from prev */
+	unsigned char *dirty;           /* per tile, output must be recomputed */
+
+	/* statistics over all frames */
+	long frames;
+	long tiles_seen;
+	long tiles_changed;
+	long tiles_recomputed;
+}TILE_CACHE;
+
+int tile_cache_init(TILE_CACHE *c, int H, int W, int tile);
+void tile_cache_free(TILE_CACHE *c);
+
+/* filter frame into c->out, returns the number of tiles recomputed */
+int tile_cache_lowpass(TILE_CACHE *c, const IMAGE *frame);
+void tile_cache_stats(const TILE_CACHE *c, FILE *f);
+
+#endif
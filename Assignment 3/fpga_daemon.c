@@ -0,0 +1,483 @@
+/* gcc -O2 -mssse3 -fopenmp -DFPGALINK fpga_daemon.c fpga_daemon_client.c fpga_replay.c image.c box_filter.c polyphase.c fpga_transport.c fpga_pipeline.c deltarle.c result_cache.c hexcodec.c "../Assignment 4/matrix_fpga.c" -lfpgalink -o fpga_daemon */
+/* without a board: gcc -O2 -mssse3 -fopenmp -DFPGA_EMULATOR fpga_daemon.c fpga_daemon_client.c fpga_replay.c image.c box_filter.c polyphase.c fpga_transport.c fpga_pipeline.c deltarle.c result_cache.c fpga_emulator.c hexcodec.c "../Assignment 4/matrix_fpga.c" -o fpga_daemon */
+
+/* Owns the board for the jobs of fpga_daemon.h. The jobs are read from
+ * every connection as their bytes come, so a slow client holds up no
+ * other. They are collected for DAEMON_WINDOW_MS after the first one is
+ * complete, then the low-pass jobs of the same frame size, region, planes
+ * and coding go through the pipeline as one
+ * sequence of frames and the matrix jobs follow back to back, so a design
+ * is loaded at most once per kind and batch. Results are kept in a cache
+ * (result_cache.h), frames and products seen before are not run again.
+ * POSIX only. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "image.h"
+#include "box_filter.h"
+#include "fpga_transport.h"
+#include "fpga_pipeline.h"
+#include "fpga_daemon.h"
+#include "result_cache.h"
+#include "../Assignment 4/matrix_fpga.h"
+
+#define DAEMON_WINDOW_MS 2	/* wait for more jobs after the first one */
+#define DAEMON_QUEUE_MAX 64	/* jobs of one batch */
+#define DAEMON_CONN_MAX 64	/* clients sending their job at the same time */
+#define DAEMON_TIMEOUT 5	/* seconds for a client to send its job or take the result */
+#define DAEMON_PIXELS_MAX (1L<<26)	/* pixels of a low-pass request */
+#define LOWPASS_ID "LP27"
+
+typedef struct JOB{
+	int s;			/* client socket */
+	long since;		/* ms when it connected */
+	size_t got;		/* bytes of r and then of data read */
+	DAEMON_REQUEST r;
+	unsigned char *data;	/* payload */
+	unsigned char *result;
+	int pending;		/* not run yet */
+	const char *error;	/* NULL when it ran fine */
+}JOB;
+
+const char *backend;
+const char *link_model;	/* "MBps:latency_us" of the emulated USB link */
+const char *program[2];	/* load the low-pass and the matrix design */
+int coded;		/* delta/run-length coded uploads for every job */
+FPGA fpga;
+const char *design;	/* identity of the design fpga is open with, NULL when closed */
+long served[3], batches, frames;
+RESULT_CACHE cache;
+volatile sig_atomic_t stop;
+
+void on_signal(int sig)
+{
+	stop=1;
+}
+
+/* have the board open with design id. Returns 0 with the reason in
+ * *error */
+int use_design(const char *id,const char *load,const char **error)
+{
+	char device[64];
+	int emulator=strcmp(backend,"emulator")==0;
+
+	if(design!=NULL && strcmp(design,id)==0)
+		return 1;
+	if(design!=NULL)
+		fpga_close(&fpga);
+	design=NULL;
+	sprintf(device,"%.32s",link_model ? link_model : "0:0");
+	switch(fpga_open_design(&fpga,backend,emulator ? device : NULL,id,load)){
+	case 0:
+		*error=fpga.error;
+		return 0;
+	case 2:
+		printf("loaded %s\n",id);
+		break;
+	case 1:
+		/* nothing could load it, so it has to be there */
+		if(load==NULL && strcmp(backend,"loopback")!=0 && !fpga_design_is(&fpga,id)){
+			fpga_close(&fpga);
+			*error="the board holds another design";
+			return 0;
+		}
+	}
+	design=id;
+	return 1;
+}
+
+static long now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec*1000L+ts.tv_nsec/1000000;
+}
+
+static int send_all(int s,const void *data,size_t n)
+{
+	const char *p=(const char *)data;
+	while(n>0){
+		ssize_t k=write(s,p,n);
+		if(k<=0)
+			return 0;
+		p+=k;
+		n-=k;
+	}
+	return 1;
+}
+
+/* a new connection, its job is read as it comes in */
+void start_job(int s,JOB *j)
+{
+	fcntl(s,F_SETFL,fcntl(s,F_GETFL) | O_NONBLOCK);
+	j->s=s;
+	j->since=now_ms();
+	j->got=0;
+	j->data=j->result=NULL;
+	j->pending=1;
+	j->error="not run";
+}
+
+void drop_job(JOB *j)
+{
+	close(j->s);
+	free(j->data);
+}
+
+int valid_request(DAEMON_REQUEST *r)
+{
+	if(r->magic!=DAEMON_MAGIC)
+		return 0;
+	if(r->kind==DAEMON_LOWPASS){
+		if(r->H<1 || r->W<1 || r->frames<1 || r->frames>DAEMON_FRAMES_MAX
+				|| (long)r->H*r->W*r->frames>DAEMON_PIXELS_MAX || !(r->planes & PLANES_ALL))
+			return 0;
+		r->planes&=PLANES_ALL;
+		r->coded=r->coded!=0;
+		return 1;
+	}
+	return r->kind==DAEMON_MATRIX;
+}
+
+/* read what the client has sent of its job so far, without waiting.
+ * Returns 1 when the job is complete, the socket then blocks again for
+ * the reply, 0 while more is to come and -1 when it is not a valid job */
+int read_job(JOB *j)
+{
+	DAEMON_REQUEST *r=&j->r;
+	struct timeval tv={DAEMON_TIMEOUT,0};
+
+	for(;;){
+		char *p;
+		size_t want;
+		ssize_t k;
+		if(j->got<sizeof(*r)){
+			p=(char *)r+j->got;
+			want=sizeof(*r)-j->got;
+		}
+		else{
+			if(j->data==NULL){
+				if(!valid_request(r))
+					return -1;
+				j->data=(unsigned char *)malloc(daemon_payload(r));
+				if(j->data==NULL)
+					return -1;
+			}
+			p=(char *)j->data+(j->got-sizeof(*r));
+			want=sizeof(*r)+daemon_payload(r)-j->got;
+			if(want==0)
+				break;
+		}
+		k=read(j->s,p,want);
+		if(k<0 && (errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR))
+			return 0;
+		if(k<=0)
+			return -1;
+		j->got+=k;
+	}
+	fcntl(j->s,F_SETFL,fcntl(j->s,F_GETFL) & ~O_NONBLOCK);
+	setsockopt(j->s,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));
+	return 1;
+}
+
+/* low-pass jobs that can share a pipeline */
+int same_lowpass(const JOB *a,const JOB *b)
+{
+	ROI ra,rb;
+	if(a->r.H!=b->r.H || a->r.W!=b->r.W || a->r.planes!=b->r.planes || a->r.coded!=b->r.coded)
+		return 0;
+	roi_clip(&a->r.roi,a->r.H,a->r.W,&ra);
+	roi_clip(&b->r.roi,b->r.H,b->r.W,&rb);
+	return memcmp(&ra,&rb,sizeof(ROI))==0;
+}
+
+/* the frames of jobs[0..n) that are like jobs[first] as one pipeline */
+void run_lowpass(JOB *jobs,int n,int first)
+{
+	const DAEMON_REQUEST *r=&jobs[first].r;
+	size_t plane=(size_t)r->H*r->W;
+	IMAGE *in,*out;
+	RESULT_KEY *key;
+	ROI roi;
+	PIPE_CODING z={0,0};
+	const char *error="out of memory";
+	int i,k,f,m=0,run=0,ok=0;
+	int params[5];
+
+	for(i=first;i<n;i++)
+		if(jobs[i].r.kind==DAEMON_LOWPASS && jobs[i].pending && same_lowpass(&jobs[i],&jobs[first])){
+			m+=jobs[i].r.frames;
+			jobs[i].result=(unsigned char *)malloc(daemon_payload(&jobs[i].r));
+			if(jobs[i].result!=NULL)
+				memcpy(jobs[i].result,jobs[i].data,daemon_payload(&jobs[i].r));
+		}
+	in=(IMAGE *)calloc(m,sizeof(IMAGE));
+	out=(IMAGE *)calloc(m,sizeof(IMAGE));
+	key=(RESULT_KEY *)calloc(m,sizeof(RESULT_KEY));
+	roi_clip(&r->roi,r->H,r->W,&roi);
+	params[0]=roi.x;
+	params[1]=roi.y;
+	params[2]=roi.w;
+	params[3]=roi.h;
+	params[4]=result_producer(backend);
+	if(in!=NULL && out!=NULL && key!=NULL){
+		/* the frames of all those jobs not in the cache in a row, over
+		 * their buffers */
+		ok=1;
+		for(i=first,f=0;i<n && ok;i++){
+			JOB *j=&jobs[i];
+			int t;
+			if(j->r.kind!=DAEMON_LOWPASS || !j->pending || !same_lowpass(j,&jobs[first]))
+				continue;
+			if(j->result==NULL){
+				ok=0;
+				break;
+			}
+			for(t=0;t<j->r.frames;t++){
+				in[run].H=out[run].H=r->H;
+				in[run].W=out[run].W=r->W;
+				for(k=0;k<NUM_PLANES;k++){
+					in[run].plane[k]=j->data+((size_t)t*NUM_PLANES+k)*plane;
+					out[run].plane[k]=j->result+((size_t)t*NUM_PLANES+k)*plane;
+				}
+				result_key_init(&key[run],RESULT_LOWPASS,params,5);
+				result_key_image(&key[run],&in[run],r->planes);
+				if(!result_cache_get_image(&cache,&key[run],&out[run],r->planes))
+					run++;
+			}
+		}
+	}
+	if(ok && run>0){
+		ok=use_design(LOWPASS_ID,program[0],&error)
+			&& pipeline_lowpass(&fpga,1,in,out,run,&roi,r->planes,NULL,coded || r->coded ? &z : NULL);
+		if(!ok && design!=NULL){
+			/* start from a fresh session with the next batch */
+			error=fpga.error;
+			fpga_close(&fpga);
+			design=NULL;
+		}
+	}
+	for(i=first;i<n;i++)
+		if(jobs[i].r.kind==DAEMON_LOWPASS && jobs[i].pending && same_lowpass(&jobs[i],&jobs[first])){
+			jobs[i].pending=0;
+			jobs[i].error=ok ? NULL : error;
+			served[DAEMON_LOWPASS]+=ok;
+		}
+	if(ok)
+		for(f=0;f<run;f++)
+			result_cache_put_image(&cache,&key[f],&out[f],r->planes);
+	frames+=ok ? m : 0;
+	if(ok)
+		printf("low-pass: %d frame%s of %d x %d, %d from the cache%s\n",m,m>1 ? "s" : "",r->W,r->H,m-run,
+			coded || r->coded ? ", coded" : "");
+	free(in);
+	free(out);
+	free(key);
+}
+
+void run_matrix(JOB *j)
+{
+	unsigned short C[MATRIX_N][MATRIX_N];
+	const char *error;
+	RESULT_KEY key;
+	int hit;
+
+	j->pending=0;
+	result_key_init(&key,RESULT_MATRIX,NULL,0);
+	result_key_add(&key,j->data,MATRIX_N*MATRIX_N);
+	result_key_add(&key,j->data+MATRIX_N*MATRIX_N,MATRIX_N*MATRIX_N);
+	hit=result_cache_get(&cache,&key,C,sizeof(C));
+	if(!hit && !use_design(MATRIX_DESIGN_ID,program[1],&error)){
+		j->error=error;
+		return;
+	}
+	if(!hit && !matrix_fpga_multiply(&fpga,(const unsigned char (*)[MATRIX_N])j->data,
+			(const unsigned char (*)[MATRIX_N])(j->data+MATRIX_N*MATRIX_N),C)){
+		j->error=fpga.error;
+		fpga_close(&fpga);
+		design=NULL;
+		return;
+	}
+	j->result=(unsigned char *)malloc(sizeof(C));
+	if(j->result==NULL){
+		j->error="out of memory";
+		return;
+	}
+	memcpy(j->result,C,sizeof(C));
+	if(!hit)
+		result_cache_put(&cache,&key,C,sizeof(C));
+	j->error=NULL;
+	served[DAEMON_MATRIX]++;
+}
+
+void reply(JOB *j)
+{
+	DAEMON_REPLY rep;
+	size_t n=j->r.kind==DAEMON_MATRIX ? MATRIX_N*MATRIX_N*sizeof(unsigned short) : daemon_payload(&j->r);
+
+	memset(&rep,0,sizeof(rep));
+	rep.ok=j->error==NULL;
+	if(!rep.ok)
+		snprintf(rep.error,DAEMON_ERROR_LEN,"%s",j->error);
+	if(send_all(j->s,&rep,sizeof(rep)) && rep.ok)
+		send_all(j->s,j->result,n);
+	close(j->s);
+	free(j->data);
+	free(j->result);
+}
+
+/* the jobs of one batch, the low-pass ones first: the design they need is
+ * usually the one loaded */
+void run_batch(JOB *jobs,int n)
+{
+	int i;
+
+	batches++;
+	for(i=0;i<n;i++)
+		if(jobs[i].r.kind==DAEMON_LOWPASS && jobs[i].pending)
+			run_lowpass(jobs,n,i);
+	for(i=0;i<n;i++)
+		if(jobs[i].r.kind==DAEMON_MATRIX)
+			run_matrix(&jobs[i]);
+	for(i=0;i<n;i++)
+		reply(&jobs[i]);
+}
+
+int main(int argc,char **argv)
+{
+	const char *path=DAEMON_SOCKET;
+	const char *cache_dir=NULL;
+	PIPE_SHAPE shape;
+	struct sockaddr_un addr;
+	struct pollfd p[DAEMON_CONN_MAX+1];
+	JOB jobs[DAEMON_QUEUE_MAX],conn[DAEMON_CONN_MAX];
+	long deadline=0;
+	int i,c,ls,n,nc=0,soft;
+
+	program[0]="sh fpga-link_init.sh";
+	program[1]="sh '../Assignment 4/fpga-link_init.sh'";
+	for(i=1;i<argc;i++){
+		if(strcmp(argv[i],"-B")==0 && i+1<argc)
+			backend=argv[++i];
+		else if(strcmp(argv[i],"-L")==0 && i+1<argc)
+			link_model=argv[++i];
+		else if(strcmp(argv[i],"-s")==0 && i+1<argc)
+			path=argv[++i];
+		else if(strcmp(argv[i],"-p")==0 && i+1<argc)
+			program[0]=argv[++i];	/* loads top_level_27 */
+		else if(strcmp(argv[i],"-m")==0 && i+1<argc)
+			program[1]=argv[++i];	/* loads Matrix_Multiplier */
+		else if(strcmp(argv[i],"-z")==0)
+			coded=1;
+		else if(strcmp(argv[i],"-C")==0 && i+1<argc)
+			cache_dir=argv[++i];	/* keep the results on disk as well */
+		else if(strcmp(argv[i],"-S")==0 && i+1<argc){
+			/* transfer shape of an earlier lowpass -A */
+			if(!pipeline_shape_load(argv[++i],&shape)){
+				printf("Cannot read %s\n",argv[i]);
+				return 1;
+			}
+			pipeline_set_shape(&shape);
+		}
+		else{
+			printf("usage: %s [-B backend] [-L MBps:us] [-s socket] [-p load_lowpass] [-m load_matrix] [-z] [-C dir] [-S shape]\n",argv[0]);
+			return 1;
+		}
+	}
+	if(backend==NULL)
+		backend=fpga_default_backend();
+	soft=strcmp(backend,"loopback")==0 || strcmp(backend,"emulator")==0;
+	if(soft)
+		program[0]=program[1]=NULL;
+	result_cache_init(&cache,RESULT_CACHE_MEM,cache_dir);
+
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family=AF_UNIX;
+	strncpy(addr.sun_path,path,sizeof(addr.sun_path)-1);
+	unlink(path);
+	ls=socket(AF_UNIX,SOCK_STREAM,0);
+	if(ls<0 || bind(ls,(struct sockaddr *)&addr,sizeof(addr))!=0 || listen(ls,DAEMON_QUEUE_MAX)!=0){
+		printf("Cannot listen on %s: %s\n",path,strerror(errno));
+		return 1;
+	}
+	signal(SIGPIPE,SIG_IGN);
+	signal(SIGINT,on_signal);
+	signal(SIGTERM,on_signal);
+	printf("fpga_daemon: %s backend on %s\n",backend,path);
+	fflush(stdout);
+
+	while(!stop){
+		/* read the connections as their bytes come, wait for a complete
+		 * job, then a little longer for the ones with it. A client gets
+		 * DAEMON_TIMEOUT to send its job */
+		for(n=0;n<DAEMON_QUEUE_MAX && !stop;){
+			long now=now_ms();
+			int wait=-1,m;
+			if(n>0 && (wait=(int)(deadline-now))<=0)
+				break;
+			for(c=0;c<nc;c++){
+				long left=conn[c].since+DAEMON_TIMEOUT*1000L-now;
+				if(wait<0 || left<wait)
+					wait=left>0 ? (int)left : 0;
+			}
+			p[0].fd=ls;
+			p[0].events=nc<DAEMON_CONN_MAX ? POLLIN : 0;
+			for(c=0;c<nc;c++){
+				p[c+1].fd=conn[c].s;
+				p[c+1].events=POLLIN;
+			}
+			if(poll(p,nc+1,wait)<0)
+				continue;
+			now=now_ms();
+			for(c=m=0;c<nc;c++){
+				int k=0;
+				if(p[c+1].revents && n<DAEMON_QUEUE_MAX)
+					k=read_job(&conn[c]);
+				if(k==0 && now-conn[c].since>=DAEMON_TIMEOUT*1000L)
+					k=-1;
+				if(k<0)
+					drop_job(&conn[c]);
+				else if(k>0){
+					if(n==0)
+						deadline=now+DAEMON_WINDOW_MS;
+					jobs[n++]=conn[c];
+				}
+				else
+					conn[m++]=conn[c];
+			}
+			nc=m;
+			if(p[0].revents & POLLIN){
+				int s=accept(ls,NULL,NULL);
+				if(s>=0)
+					start_job(s,&conn[nc++]);
+			}
+		}
+		if(n>0){
+			run_batch(jobs,n);
+			fflush(stdout);
+		}
+	}
+	for(c=0;c<nc;c++)
+		drop_job(&conn[c]);
+
+	printf("fpga_daemon: %ld low-pass and %ld matrix jobs in %ld batches, %ld frames\n",
+		served[DAEMON_LOWPASS],served[DAEMON_MATRIX],batches,frames);
+	result_cache_stats(&cache,stdout);
+	result_cache_free(&cache);
+	if(design!=NULL)
+		fpga_close(&fpga);
+	close(ls);
+	unlink(path);
+	return 0;
+}
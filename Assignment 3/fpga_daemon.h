@@ -0,0 +1,55 @@
+/* Job daemon that owns the board, so short jobs from many processes cost
+ * only their transfers: fpga_daemon.c opens the device once, loads a
+ * design only when a job needs the other one, and runs the low-pass jobs
+ * that arrive together as one pipeline (fpga_pipeline.h).
+ * A client connects to the Unix socket, sends a DAEMON_REQUEST and its
+ * payload, and reads a DAEMON_REPLY and the result:
+ *   DAEMON_LOWPASS  frames x NUM_PLANES planes of H x W bytes, blue first.
+ *                   The result has the same layout, roi filtered in the
+ *                   planes of the mask and the rest as sent
+ *   DAEMON_MATRIX   A and B, 16 x 16 bytes each, row by row. The result
+ *                   is C as 16 x 16 unsigned shorts
+ * Both ends are on the same host, the structures go as they are in memory.
+ */
+
+#ifndef FPGA_DAEMON_H
+#define FPGA_DAEMON_H
+
+#include "image.h"
+#include "box_filter.h"
+
+#define DAEMON_SOCKET "/tmp/fpga_daemon.sock"
+#define DAEMON_MAGIC 0x4a475046	/* "FPGJ" */
+#define DAEMON_LOWPASS 1
+#define DAEMON_MATRIX 2
+#define DAEMON_FRAMES_MAX 256	/* frames of one low-pass request */
+#define DAEMON_ERROR_LEN 96
+
+typedef struct DAEMON_REQUEST{
+	unsigned magic;
+	int kind;
+	int H, W, frames;	/* of a low-pass, 0 for a matrix */
+	int planes;
+	ROI roi;		/* w = 0 for the whole frame */
+	int coded;		/* upload the phases delta/run-length coded */
+}DAEMON_REQUEST;
+
+typedef struct DAEMON_REPLY{
+	int ok;
+	char error[DAEMON_ERROR_LEN];	/* when ok is 0, no result follows */
+}DAEMON_REPLY;
+
+/* bytes of the payload of r, the same for its low-pass result */
+size_t daemon_payload(const DAEMON_REQUEST *r);
+
+/* the jobs below return 1 with the result, else 0 and a message in error,
+ * at least DAEMON_ERROR_LEN bytes. path NULL is DAEMON_SOCKET */
+
+/* filter roi (NULL for the whole frame) of n frames of the same size,
+ * coded as lowpass_fpga -z does */
+int daemon_lowpass(const char *path, const IMAGE *in, IMAGE *out, int n, const ROI *roi, int planes,
+		int coded, char *error);
+int daemon_matrix(const char *path, const unsigned char A[16][16], const unsigned char B[16][16],
+		unsigned short C[16][16], char *error);
+
+#endif
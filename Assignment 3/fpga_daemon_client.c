@@ -0,0 +1,161 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "fpga_daemon.h"
+
+size_t daemon_payload(const DAEMON_REQUEST *r)
+{
+	if(r->kind == DAEMON_MATRIX)
+		return 2*16*16;
+	return (size_t)r->frames*NUM_PLANES*r->H*r->W;
+}
+
+#ifdef _WIN32
+
+int daemon_lowpass(const char *path, const IMAGE *in, IMAGE *out, int n, const ROI *roi, int planes,
+		int coded, char *error)
+{
+	strcpy(error, "the daemon needs Unix sockets");
+	return 0;
+}
+
+int daemon_matrix(const char *path, const unsigned char A[16][16], const unsigned char B[16][16],
+		unsigned short C[16][16], char *error)
+{
+	strcpy(error, "the daemon needs Unix sockets");
+	return 0;
+}
+
+#else
+
+static int send_all(int s, const void *data, size_t n)
+{
+	const char *p = (const char *)data;
+	while(n > 0){
+		ssize_t k = write(s, p, n);
+		if(k <= 0)
+			return 0;
+		p += k;
+		n -= k;
+	}
+	return 1;
+}
+
+static int recv_all(int s, void *data, size_t n)
+{
+	char *p = (char *)data;
+	while(n > 0){
+		ssize_t k = read(s, p, n);
+		if(k <= 0)
+			return 0;
+		p += k;
+		n -= k;
+	}
+	return 1;
+}
+
+/* send r and its payload, returns the socket with the reply header read
+ * and ok, or -1 with error set */
+static int job(const char *path, const DAEMON_REQUEST *r, const unsigned char *payload, char *error)
+{
+	struct sockaddr_un addr;
+	DAEMON_REPLY reply;
+	int s;
+
+	if(path == NULL)
+		path = DAEMON_SOCKET;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(s < 0 || connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0){
+		snprintf(error, DAEMON_ERROR_LEN, "no daemon on %.60s", path);
+		if(s >= 0)
+			close(s);
+		return -1;
+	}
+	if(!send_all(s, r, sizeof(*r)) || !send_all(s, payload, daemon_payload(r))
+			|| !recv_all(s, &reply, sizeof(reply))){
+		strcpy(error, "the daemon closed the connection");
+		close(s);
+		return -1;
+	}
+	if(!reply.ok){
+		reply.error[DAEMON_ERROR_LEN-1] = 0;
+		strcpy(error, reply.error);
+		close(s);
+		return -1;
+	}
+	return s;
+}
+
+int daemon_lowpass(const char *path, const IMAGE *in, IMAGE *out, int n, const ROI *roi, int planes,
+		int coded, char *error)
+{
+	DAEMON_REQUEST r;
+	unsigned char *buf;
+	size_t plane;
+	int s, i, k, ok;
+
+	memset(&r, 0, sizeof(r));
+	r.magic = DAEMON_MAGIC;
+	r.kind = DAEMON_LOWPASS;
+	r.H = in[0].H;
+	r.W = in[0].W;
+	r.frames = n;
+	r.planes = planes;
+	r.coded = coded;
+	if(roi != NULL)
+		r.roi = *roi;
+	plane = (size_t)r.H*r.W;
+	buf = (unsigned char *)malloc(daemon_payload(&r));
+	if(buf == NULL){
+		strcpy(error, "out of memory");
+		return 0;
+	}
+	for(i=0;i<n;i++)
+		for(k=0;k<NUM_PLANES;k++)
+			memcpy(buf + (i*NUM_PLANES + k)*plane, in[i].plane[k], plane);
+	s = job(path, &r, buf, error);
+	ok = s >= 0 && recv_all(s, buf, daemon_payload(&r));
+	if(s >= 0 && !ok)
+		strcpy(error, "the daemon closed the connection");
+	if(ok)
+		for(i=0;i<n;i++)
+			for(k=0;k<NUM_PLANES;k++)
+				memcpy(out[i].plane[k], buf + (i*NUM_PLANES + k)*plane, plane);
+	if(s >= 0)
+		close(s);
+	free(buf);
+	return ok;
+}
+
+int daemon_matrix(const char *path, const unsigned char A[16][16], const unsigned char B[16][16],
+		unsigned short C[16][16], char *error)
+{
+	DAEMON_REQUEST r;
+	unsigned char buf[2*16*16];
+	int s, ok;
+
+	memset(&r, 0, sizeof(r));
+	r.magic = DAEMON_MAGIC;
+	r.kind = DAEMON_MATRIX;
+	memcpy(buf, A, 16*16);
+	memcpy(buf + 16*16, B, 16*16);
+	s = job(path, &r, buf, error);
+	if(s < 0)
+		return 0;
+	ok = recv_all(s, C, 16*16*sizeof(unsigned short));
+	if(!ok)
+		strcpy(error, "the daemon closed the connection");
+	close(s);
+	return ok;
+}
+
+#endif
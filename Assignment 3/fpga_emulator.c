@@ -0,0 +1,373 @@
+/* Software model of top_level_27.vhdl behind the transport, so the host
+ * runs end to end without a board. It keeps the channel contract of the
+ * fabric:
+ *   1..9, 0x11..0x19, 0x21..0x29  phase BRAMs of blue, green and red.
+ *                                 A write stores at addra, a read returns
+ *                                 doutb, both addresses count up per byte
+ *                                 and the first byte read is stale
+ *   0x00                          resets every addrb and the output
+ *                                 addresses, reads the switches
+ *   0x0b, 0x0c                    last column and row of the window
+ *   0x0d                          bit 0 decodes the phase writes as in
+ *                                 deltarle.h
+ *   0x0e                          bank register, see EMU_BANK_DEPTH.
+ *                                 Bit 1 set goes back to whole BRAMs
+ *   0x10                          runs the 3x3 low-pass over the window
+ *                                 as the fabric does, see emu_compute
+ *   0x31..0x33                    output BRAMs, the window row by row.
+ *                                 The filter writes and a read returns
+ *                                 from one address, the first byte read
+ *                                 is stale
+ *   0x7f                          design identity EMU_DESIGN_ID
+ * The phase BRAMs keep the input, the host reads the result from the
+ * output BRAMs after rewinding them. The window is 256x256 until 0x0b and
+ * 0x0c are written. The device string "[MBps[:latency_us]]" models the
+ * link: with a bandwidth or latency every transfer waits
+ * latency + bytes / bandwidth like the USB link would, the filter takes a cycle per pixel and the
+ * modelled times are printed on close.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "fpga_transport.h"
+#include "polyphase.h"
+
+#define EMU_PHASES 3
+#define EMU_BRAM_DEPTH 8192	/* 13-bit addresses of the phase BRAMs */
+#define EMU_BANK_DEPTH 4096	/* after a write to 0x0e, bit 12 is the bank */
+#define EMU_OUT_DEPTH 65536	/* 16-bit addresses of the output BRAMs */
+#define EMU_WIN_MAX 256		/* 8-bit window registers */
+#define EMU_CLOCK 48e6		/* fabric clock, one pixel per cycle */
+#define EMU_DESIGN_ID "LP27"
+
+typedef struct EMU_BRAM{
+	unsigned char mem[EMU_BRAM_DEPTH];
+	unsigned addra, addrb;	/* within the bank when banked */
+	unsigned char doutb;	/* registered output, one read behind */
+}EMU_BRAM;
+
+typedef struct EMULATOR{
+	int W, H;		/* window the filter runs over */
+	double bandwidth;	/* bytes per second, 0 for no limit */
+	double latency;		/* seconds per transfer */
+	int banked, bank;	/* the host sees bank, the filter the other one */
+	EMU_BRAM bram[NUM_PLANES][EMU_PHASES*EMU_PHASES];
+	unsigned char out[NUM_PLANES][EMU_OUT_DEPTH];
+	unsigned addr_out[NUM_PLANES];
+	unsigned char dout[NUM_PLANES];
+	int chan;		/* selected channel */
+	int id_index;		/* next byte of the identity */
+
+	/* upload decoder, restarts on every channel change */
+	int z_mode, z_state;	/* state: 0 control byte, 1 literal, 2 run, 3 repeat */
+	int z_count;		/* bytes left in the literal or repeat */
+	unsigned char z_prev, z_delta;
+
+	/* modelled time in seconds */
+	double now;		/* since open */
+	double busy_until;	/* the filter is running until then */
+	double usb_time, compute_time, stall_time;
+	size_t bytes_in, bytes_out;
+	long transfers;
+}EMULATOR;
+
+static int emu_modelled(const EMULATOR *e)
+{
+	return e->bandwidth > 0 || e->latency > 0;
+}
+
+static void emu_sleep(double t)
+{
+	if(t <= 0)
+		return;
+#ifdef _WIN32
+	Sleep((DWORD)(t * 1e3));
+#else
+	{
+		struct timespec ts;
+		ts.tv_sec = (time_t)t;
+		ts.tv_nsec = (long)((t - ts.tv_sec) * 1e9);
+		nanosleep(&ts, NULL);
+	}
+#endif
+}
+
+static void emu_wait(EMULATOR *e, size_t n)
+{
+	double t = e->latency;
+	if(e->bandwidth > 0)
+		t += n / e->bandwidth;
+	e->usb_time += t;
+	e->now += t;
+	e->transfers++;
+	emu_sleep(t);
+}
+
+/* hold the host until the filter is done with the BRAMs it wants */
+static void emu_stall(EMULATOR *e)
+{
+	double t = e->busy_until - e->now;
+	if(t <= 0)
+		return;
+	e->stall_time += t;
+	e->now = e->busy_until;
+	emu_sleep(t);
+}
+
+static int emu_open(void **ctx, const char *device, const char **error)
+{
+	EMULATOR *e = (EMULATOR *)calloc(1, sizeof(EMULATOR));
+	double mbps = 0, us = 0;
+
+	if(e==NULL){
+		*error = "out of memory";
+		return 0;
+	}
+	sscanf(device, "%lf:%lf", &mbps, &us);
+	e->W = EMU_WIN_MAX;
+	e->H = EMU_WIN_MAX;
+	e->bandwidth = mbps * 1e6;
+	e->latency = us * 1e-6;
+	*ctx = e;
+	return 1;
+}
+
+/* phase BRAM of a channel, NULL for the other channels */
+static EMU_BRAM *emu_bram(EMULATOR *e, int chan)
+{
+	int k = chan >> 4, p = (chan & 15) - 1;
+	if(k >= NUM_PLANES || p < 0 || p >= EMU_PHASES*EMU_PHASES)
+		return NULL;
+	return &e->bram[k][p];
+}
+
+/* BRAM cell of address a in bank */
+static size_t emu_cell(const EMULATOR *e, size_t a, int bank)
+{
+	if(e->banked)
+		return (size_t)bank*EMU_BANK_DEPTH + a % EMU_BANK_DEPTH;
+	return a % EMU_BRAM_DEPTH;
+}
+
+static unsigned emu_next(const EMULATOR *e, unsigned a)
+{
+	return (a + 1) % (e->banked ? EMU_BANK_DEPTH : EMU_BRAM_DEPTH);
+}
+
+/* address in phase BRAM (pr, pc) of the neighbour of pixel (i, j) with
+ * those phases, as phaseAddr of top_level_27. A phase keeps its rows one
+ * after the other, row r at r/3, column c at c/3 */
+static size_t emu_phase_addr(const EMULATOR *e, int i, int j, int pr, int pc)
+{
+	int r = i - 1 + ((pr - i + 1) % EMU_PHASES + EMU_PHASES) % EMU_PHASES;
+	int c = j - 1 + ((pc - j + 1) % EMU_PHASES + EMU_PHASES) % EMU_PHASES;
+
+	if(r < 0)
+		r += EMU_PHASES;
+	if(c < 0)
+		c += EMU_PHASES;
+	return (size_t)(r/EMU_PHASES)*PHASE_LEN(e->W, EMU_PHASES, pc) + c/EMU_PHASES;
+}
+
+/* the filter of top_level_27 over the window in the bank the host does not
+ * see. A pixel on the border of the window comes from its own BRAM, phase
+ * (i%3, j%3), the others are the 12-bit sum of the nine BRAMs at their
+ * neighbour divided by 9. The result goes into the output BRAMs from
+ * their current address on */
+static void emu_compute(EMULATOR *e)
+{
+	int k, i, j, p, bank = e->banked ? !e->bank : 0;
+
+	for(i=0;i<e->H;i++)
+		for(j=0;j<e->W;j++)
+			for(k=0;k<NUM_PLANES;k++){
+				EMU_BRAM *b = e->bram[k];
+				unsigned v = 0;
+				if(i == 0 || i == e->H-1 || j == 0 || j == e->W-1){
+					p = i%EMU_PHASES + EMU_PHASES*(j%EMU_PHASES);
+					v = b[p].mem[emu_cell(e, emu_phase_addr(e, i, j, i%EMU_PHASES, j%EMU_PHASES), bank)];
+				}
+				else{
+					for(p=0;p<EMU_PHASES*EMU_PHASES;p++)
+						v += b[p].mem[emu_cell(e, emu_phase_addr(e, i, j, p%EMU_PHASES, p/EMU_PHASES), bank)];
+					v = (v & 0xfff) / 9;
+				}
+				e->out[k][e->addr_out[k]] = (unsigned char)v;
+				e->addr_out[k] = (e->addr_out[k] + 1) % EMU_OUT_DEPTH;
+			}
+	e->compute_time += (double)e->W*e->H / EMU_CLOCK;
+	if(emu_modelled(e))
+		e->busy_until = e->now + (double)e->W*e->H / EMU_CLOCK;
+}
+
+static void emu_store(EMULATOR *e, EMU_BRAM *b, unsigned char v)
+{
+	b->mem[emu_cell(e, b->addra, e->bank)] = v;
+	b->addra = emu_next(e, b->addra);
+}
+
+/* selecting channel 0 or 0x10 has its effect whatever the direction. The
+ * host waits for the filter before it touches the same BRAMs, the window
+ * or the output addresses, with banks that is only at the next rewind,
+ * bank switch, window change or read of the output BRAMs */
+static void emu_select(EMULATOR *e, int chan)
+{
+	int k, p;
+	if(chan != e->chan){
+		/* the fabric reads the channel of the next command without
+		 * waiting for a repeat, its next byte goes to the new channel
+		 * and the rest is lost */
+		if(e->z_state == 3 && emu_bram(e, chan) != NULL)
+			emu_store(e, emu_bram(e, chan), (unsigned char)(e->z_prev + e->z_delta));
+		e->id_index = 0;
+		e->z_state = 0;
+		e->z_prev = 0;
+	}
+	e->chan = chan;
+	if(chan == 0){
+		emu_stall(e);
+		for(k=0;k<NUM_PLANES;k++){
+			for(p=0;p<EMU_PHASES*EMU_PHASES;p++)
+				e->bram[k][p].addrb = 0;
+			e->addr_out[k] = 0;
+		}
+	}
+	else if(chan == 0x10){
+		emu_stall(e);
+		emu_compute(e);
+	}
+	else if(chan == 0x0b || chan == 0x0c || chan == 0x0e || chan >> 4 == 3
+			|| (!e->banked && emu_bram(e, chan) != NULL))
+		emu_stall(e);
+}
+
+/* the decoder of top_level_27. The difference of a run is stored once,
+ * the repeats only when the channel sends its next byte, as h2fReady holds
+ * that off until they are out */
+static void emu_decode(EMULATOR *e, EMU_BRAM *b, const unsigned char *data, size_t n)
+{
+	size_t i;
+
+	for(i=0;i<n;i++){
+		unsigned char c = data[i];
+		for(;e->z_state == 3 && e->z_count > 0;e->z_count--)
+			emu_store(e, b, e->z_prev = (unsigned char)(e->z_prev + e->z_delta));
+		if(e->z_state == 3)
+			e->z_state = 0;
+		if(e->z_state == 0){
+			e->z_count = (c & 0x7f) + 1;
+			e->z_state = c & 0x80 ? 2 : 1;
+		}
+		else if(e->z_state == 1){
+			emu_store(e, b, e->z_prev = (unsigned char)(e->z_prev + c));
+			if(--e->z_count == 0)
+				e->z_state = 0;
+		}
+		else{
+			emu_store(e, b, e->z_prev = (unsigned char)(e->z_prev + c));
+			e->z_delta = c;
+			e->z_state = 3;
+		}
+	}
+}
+
+static int emu_write(void *ctx, int chan, const unsigned char *data, size_t n, const char **error)
+{
+	EMULATOR *e = (EMULATOR *)ctx;
+	EMU_BRAM *b = emu_bram(e, chan);
+	size_t i;
+	int k, p;
+	(void)error;
+
+	emu_select(e, chan);
+	if(b != NULL && e->z_mode)
+		emu_decode(e, b, data, n);
+	else if(b != NULL)
+		for(i=0;i<n;i++)
+			emu_store(e, b, data[i]);
+	else if(chan == 0x0b && n > 0)
+		e->W = data[n-1] + 1;
+	else if(chan == 0x0c && n > 0)
+		e->H = data[n-1] + 1;
+	else if(chan == 0x0d && n > 0)
+		e->z_mode = data[n-1] & 1;
+	else if(chan == 0x0e && n > 0){
+		/* switch banks or unbank and rewind, the last byte counts */
+		e->bank = data[n-1] & 1;
+		e->banked = !(data[n-1] & 2);
+		for(k=0;k<NUM_PLANES;k++)
+			for(p=0;p<EMU_PHASES*EMU_PHASES;p++)
+				e->bram[k][p].addra = e->bram[k][p].addrb = 0;
+	}
+	e->bytes_in += n;
+	emu_wait(e, n);
+	return 1;
+}
+
+static int emu_read(void *ctx, int chan, unsigned char *data, size_t n, const char **error)
+{
+	EMULATOR *e = (EMULATOR *)ctx;
+	EMU_BRAM *b = emu_bram(e, chan);
+	int k = (chan >> 4) - 3, p = chan & 15;
+	size_t i;
+	(void)error;
+
+	emu_select(e, chan);
+	if(b != NULL){
+		emu_stall(e);	/* port b is the filter's while it runs */
+		for(i=0;i<n;i++){
+			data[i] = b->doutb;
+			b->doutb = b->mem[emu_cell(e, b->addrb, e->bank)];
+			b->addrb = emu_next(e, b->addrb);
+		}
+	}
+	else if(k == 0 && p >= 1 && p <= NUM_PLANES)
+		for(i=0;i<n;i++){
+			data[i] = e->dout[p-1];
+			e->dout[p-1] = e->out[p-1][e->addr_out[p-1]];
+			e->addr_out[p-1] = (e->addr_out[p-1] + 1) % EMU_OUT_DEPTH;
+		}
+	else if(chan == 0x0b)
+		memset(data, e->W - 1, n);
+	else if(chan == 0x0c)
+		memset(data, e->H - 1, n);
+	else if(chan == 0x0e)
+		memset(data, e->bank | !e->banked << 1, n);
+	else if(chan == FPGA_ID_CHAN)
+		for(i=0;i<n;i++){
+			data[i] = (unsigned char)EMU_DESIGN_ID[e->id_index];
+			e->id_index = (e->id_index + 1) % FPGA_ID_LEN;
+		}
+	else
+		memset(data, 0, n);	/* the switches and unused channels */
+	e->bytes_out += n;
+	emu_wait(e, n);
+	return 1;
+}
+
+static void emu_close(void *ctx)
+{
+	EMULATOR *e = (EMULATOR *)ctx;
+	printf("emulator: %lu bytes in, %lu bytes out, %ld transfers\n",
+		(unsigned long)e->bytes_in, (unsigned long)e->bytes_out, e->transfers);
+	printf("emulator: %.3f ms USB, %.3f ms fabric, %.3f ms stalled, %.3f ms in all\n",
+		e->usb_time * 1e3, e->compute_time * 1e3, e->stall_time * 1e3, e->now * 1e3);
+	free(e);
+}
+
+/* any number of boards side by side, each with its own state */
+static int emu_enumerate(const char *device, int index, char *name)
+{
+	(void)index;
+	strcpy(name, device);
+	return 1;
+}
+
+const FPGA_BACKEND fpga_emulator_backend = { "emulator", emu_open, emu_write, emu_read, emu_close, NULL, NULL, emu_enumerate };
@@ -0,0 +1,546 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "fpga_pipeline.h"
+#include "polyphase.h"
+#include "deltarle.h"
+
+static PIPE_SHAPE shape = { 0, PIPE_ORDER_PLANE };
+static const char *order_names[PIPE_ORDERS] = { "plane", "phase", "interleave" };
+
+/* channel of phase p of plane k */
+static int phase_chan(int k, int p)
+{
+	return 16*k + 1 + p;
+}
+
+/* one upload buffer, phases of the requested planes in order, or one
+ * readback buffer, the window of each requested plane */
+typedef struct PIPE_BUF{
+	unsigned char *data;
+	unsigned char *phase[NUM_PLANES][PIPE_PHASES*PIPE_PHASES];
+	FPGA_READ rd[NUM_PLANES*PIPE_PHASES*PIPE_PHASES];
+	int count;
+	unsigned char *coded;	/* the phases coded, NULL to send them raw */
+	FPGA_READ zd[NUM_PLANES*PIPE_PHASES*PIPE_PHASES];
+	size_t raw, sent;
+}PIPE_BUF;
+
+/* lay out buf for the phases of win */
+static int pipe_buf_init(PIPE_BUF *b, const ROI *win, int planes, int coded)
+{
+	size_t o = 0, bytes = (size_t)NUM_PLANES*(win->w*win->h + PIPE_PHASES*PIPE_PHASES);
+	int k, p;
+
+	b->data = (unsigned char *)malloc(bytes);
+	b->coded = coded ? (unsigned char *)malloc(DRLE_BOUND(bytes)) : NULL;
+	if(b->data == NULL || (coded && b->coded == NULL))
+		return 0;
+	b->count = 0;
+	for(k=0;k<NUM_PLANES;k++){
+		if(!(planes & (1<<k)))
+			continue;
+		for(p=0;p<PIPE_PHASES*PIPE_PHASES;p++){
+			FPGA_READ *r = &b->rd[b->count++];
+			r->chan = phase_chan(k, p);
+			r->data = b->data + o;
+			r->n = polyphase_len(win, PIPE_PHASES, p%PIPE_PHASES, p/PIPE_PHASES);
+			b->phase[k][p] = b->data + o;
+			o += r->n;
+		}
+	}
+	return 1;
+}
+
+/* lay out buf for the output BRAMs, win row by row after the stale first
+ * byte of each plane */
+static int pipe_out_init(PIPE_BUF *b, const ROI *win, int planes)
+{
+	size_t o = 0, n = (size_t)win->w*win->h + 1;
+	int k;
+
+	b->data = (unsigned char *)malloc(NUM_PLANES*n);
+	if(b->data == NULL)
+		return 0;
+	b->count = 0;
+	for(k=0;k<NUM_PLANES;k++){
+		FPGA_READ *r;
+		if(!(planes & (1<<k)))
+			continue;
+		r = &b->rd[b->count++];
+		r->chan = PIPE_OUT_CHAN + k;
+		r->data = b->data + o;
+		r->n = n;
+		b->phase[k][0] = b->data + o + 1;
+		o += n;
+	}
+	return 1;
+}
+
+static void scatter(PIPE_BUF *b, const PIPE_JOB *job, int planes)
+{
+	size_t o = 0;
+	int i, k, p;
+	for(k=0;k<NUM_PLANES;k++)
+		if(planes & (1<<k))
+			for(p=0;p<PIPE_PHASES*PIPE_PHASES;p++)
+				polyphase_scatter(job->in->plane[k], job->in->W, &job->win, PIPE_PHASES,
+					p%PIPE_PHASES, p/PIPE_PHASES, b->phase[k][p]);
+	if(b->coded == NULL)
+		return;
+	/* each phase on its own, the fabric restarts the decoder with the
+	 * channel */
+	for(i=0;i<b->count;i++){
+		b->zd[i].chan = b->rd[i].chan;
+		b->zd[i].data = b->coded + o;
+		b->zd[i].n = drle_encode(b->rd[i].data, b->rd[i].n, b->coded + o);
+		b->raw += b->rd[i].n;
+		b->sent += b->zd[i].n;
+		o += b->zd[i].n;
+	}
+}
+
+/* the roi rows of the window into the frame */
+static void gather(PIPE_BUF *b, const PIPE_JOB *job, int planes)
+{
+	const ROI *w = &job->win, *r = &job->roi;
+	int k, i;
+	for(k=0;k<NUM_PLANES;k++)
+		if(planes & (1<<k))
+			for(i=r->y;i<r->y+r->h;i++)
+				memcpy(job->out->plane[k] + (size_t)i*job->out->W + r->x,
+					b->phase[k][0] + (size_t)(i - w->y)*w->w + r->x - w->x, r->w);
+}
+
+/* the count phase transfers of list cut and ordered by shape, NULL when
+ * out of memory. A phase keeps its chunks together when together is set */
+static FPGA_READ *shaped(const FPGA_READ *list, int count, int together, int *m)
+{
+	size_t chunk = shape.chunk, o;
+	long pieces = 0;
+	int i, k, c, more, np = count / (PIPE_PHASES*PIPE_PHASES);
+	FPGA_READ *s;
+
+	for(i=0;i<count;i++)
+		pieces += chunk > 0 && list[i].n > chunk ? (long)((list[i].n + chunk - 1) / chunk) : 1;
+	s = (FPGA_READ *)malloc(pieces*sizeof(FPGA_READ));
+	if(s == NULL)
+		return NULL;
+	*m = 0;
+	if(shape.order == PIPE_ORDER_INTERLEAVE && chunk > 0 && !together){
+		for(c=0,more=1;more;c++)
+			for(i=0,more=0;i<count;i++){
+				o = (size_t)c * chunk;
+				if(o >= list[i].n)
+					continue;
+				s[*m] = list[i];
+				s[*m].data += o;
+				s[(*m)++].n = list[i].n - o < chunk ? list[i].n - o : chunk;
+				more = 1;
+			}
+		return s;
+	}
+	for(k=0;k<count;k++){
+		/* list has the phases of a plane in a row */
+		i = shape.order == PIPE_ORDER_PHASE && np > 0 ? (k % np)*PIPE_PHASES*PIPE_PHASES + k / np : k;
+		o = 0;
+		do{
+			s[*m] = list[i];
+			s[*m].data += o;
+			s[*m].n = chunk > 0 && list[i].n - o > chunk ? chunk : list[i].n - o;
+			o += s[(*m)++].n;
+		}while(o < list[i].n);
+	}
+	return s;
+}
+
+/* the phase writes of list in the shape, as few batches as they fit */
+static int write_shaped(FPGA *f, FPGA_BATCH *batch, const FPGA_READ *list, int count, int together)
+{
+	FPGA_READ *s = shaped(list, count, together, &count);
+	int i, ok = 1;
+
+	if(s == NULL){
+		f->error = "out of memory";
+		return 0;
+	}
+	for(i=0;i<count && ok;i++)
+		if(!fpga_batch_add(batch, s[i].chan, s[i].data, s[i].n)){
+			ok = fpga_batch_flush(f, batch);
+			fpga_batch_add(batch, s[i].chan, s[i].data, s[i].n);
+		}
+	ok = ok && fpga_batch_flush(f, batch);
+	free(s);
+	return ok;
+}
+
+static int read_shaped(FPGA *f, const FPGA_READ *list, int count)
+{
+	FPGA_READ *s = shaped(list, count, 0, &count);
+	int i, ok = 1;
+
+	if(s == NULL){
+		f->error = "out of memory";
+		return 0;
+	}
+	for(i=0;i<count && ok;i+=FPGA_BATCH_MAX)
+		ok = fpga_read_batch(f, s + i, count - i < FPGA_BATCH_MAX ? count - i : FPGA_BATCH_MAX);
+	free(s);
+	return ok;
+}
+
+/* the link side of step t: read frame t-2 back from the output BRAMs,
+ * switch banks, start the filter on frame t-1 and upload frame t into the
+ * bank the host sees. The filter writes the output BRAMs from where
+ * channel 0 left their address, so it rewinds them before each. The
+ * first step sets the fabric to the window of the jobs */
+static int transfer(FPGA *f, const ROI *win, PIPE_BUF *up, PIPE_BUF *rd, long t, long n)
+{
+	static const unsigned char strobe = 0;
+	unsigned char bank = (unsigned char)(t & 1), coding = up->coded != NULL;
+	unsigned char last[2];
+	const FPGA_READ *w = up->coded != NULL ? up->zd : up->rd;
+	FPGA_BATCH batch;
+
+	fpga_batch_init(&batch);
+	fpga_phase(f, FPGA_PHASE_READBACK);
+	if(t >= 2){
+		fpga_batch_add(&batch, PIPE_REWIND_CHAN, &strobe, 1);
+		if(!fpga_batch_flush(f, &batch) || !read_shaped(f, rd->rd, rd->count))
+			return 0;
+	}
+	fpga_phase(f, FPGA_PHASE_COMPUTE);
+	/* the board keeps the coding and window of the last run */
+	if(t == 0){
+		last[0] = (unsigned char)(win->w - 1);
+		last[1] = (unsigned char)(win->h - 1);
+		fpga_batch_add(&batch, PIPE_CODING_CHAN, &coding, 1);
+		fpga_batch_add(&batch, PIPE_WIDTH_CHAN, &last[0], 1);
+		fpga_batch_add(&batch, PIPE_HEIGHT_CHAN, &last[1], 1);
+	}
+	fpga_batch_add(&batch, PIPE_BANK_CHAN, &bank, 1);
+	if(t >= 1 && t <= n){
+		fpga_batch_add(&batch, PIPE_REWIND_CHAN, &strobe, 1);
+		fpga_batch_add(&batch, PIPE_FILTER_CHAN, &strobe, 1);
+	}
+	if(!fpga_batch_flush(f, &batch))
+		return 0;
+	fpga_phase(f, FPGA_PHASE_UPLOAD);
+	if(t < n && !write_shaped(f, &batch, w, up->count, up->coded != NULL))
+		return 0;
+	return 1;
+}
+
+int pipeline_fits(const ROI *win, size_t depth)
+{
+	int p;
+	if(win->w > PIPE_WINDOW_MAX || win->h > PIPE_WINDOW_MAX)
+		return 0;
+	for(p=0;p<PIPE_PHASES*PIPE_PHASES;p++)
+		if(polyphase_len(win, PIPE_PHASES, p%PIPE_PHASES, p/PIPE_PHASES) > depth)
+			return 0;
+	return 1;
+}
+
+void pipeline_tile_size(const ROI *win, int *w, int *h)
+{
+	int side = 3*64;	/* 64 x 64 samples a phase */
+	*h = win->h < side ? win->h : side;
+	*w = PIPE_PHASES*(PIPE_BANK_DEPTH / PHASE_LEN(*h, PIPE_PHASES, 0));
+	if(*w >= win->w){
+		/* narrow windows get taller tiles instead */
+		*w = win->w;
+		*h = PIPE_PHASES*(PIPE_BANK_DEPTH / PHASE_LEN(*w, PIPE_PHASES, 0));
+		if(*h > win->h)
+			*h = win->h;
+	}
+	if(*w > PIPE_WINDOW_MAX)
+		*w = PIPE_WINDOW_MAX;
+	if(*h > PIPE_WINDOW_MAX)
+		*h = PIPE_WINDOW_MAX;
+}
+
+/* next span of inner pixels from x on an axis of n pixels with tiles of
+ * w, the tile starts at *x0. A tile edge that is not the frame edge is
+ * halo and not written */
+static int tile_span(int x, int n, int w, int *x0)
+{
+	*x0 = x - 1 < 0 ? 0 : x - 1;
+	if(*x0 > n - w)
+		*x0 = n - w;
+	return *x0 + w == n ? n : *x0 + w - 1;
+}
+
+long pipeline_tiles(const ROI *roi, int H, int W, int w, int h, PIPE_JOB *jobs)
+{
+	long count = 0;
+	int x, y, x0, y0, xe, ye;
+
+	for(y=roi->y;y<roi->y+roi->h;y=ye){
+		ye = tile_span(y, H, h, &y0);
+		if(ye > roi->y + roi->h)
+			ye = roi->y + roi->h;
+		for(x=roi->x;x<roi->x+roi->w;x=xe){
+			xe = tile_span(x, W, w, &x0);
+			if(xe > roi->x + roi->w)
+				xe = roi->x + roi->w;
+			if(jobs != NULL){
+				PIPE_JOB *j = &jobs[count];
+				j->roi.x = x;
+				j->roi.y = y;
+				j->roi.w = xe - x;
+				j->roi.h = ye - y;
+				j->win.x = x0;
+				j->win.y = y0;
+				j->win.w = w;
+				j->win.h = h;
+			}
+			count++;
+		}
+	}
+	return count;
+}
+
+int pipeline_run(FPGA *f, const PIPE_JOB *jobs, long n, int planes, PIPE_CODING *z)
+{
+	PIPE_BUF up[2], rd[2];
+	long t;
+	int ok = 1;
+
+	if(n < 1)
+		return 1;
+	if(!pipeline_fits(&jobs[0].win, PIPE_BANK_DEPTH)){
+		f->error = "window does not fit a BRAM bank";
+		return 0;
+	}
+	up[0].data = up[1].data = rd[0].data = rd[1].data = NULL;
+	up[0].coded = up[1].coded = rd[0].coded = rd[1].coded = NULL;
+	for(t=0;t<2;t++){
+		up[t].raw = up[t].sent = 0;
+		if(!pipe_buf_init(&up[t], &jobs[0].win, planes, z != NULL)
+				|| !pipe_out_init(&rd[t], &jobs[0].win, planes)){
+			f->error = "out of memory";
+			ok = 0;
+		}
+	}
+
+	if(ok)
+		scatter(&up[0], &jobs[0], planes);
+	/* step t uses up[t&1] and rd[t&1] on the link, the CPU works on the
+	 * other pair */
+	for(t=0;t<n+2 && ok;t++){
+		#pragma omp parallel sections
+		{
+			#pragma omp section
+			ok = transfer(f, &jobs[0].win, &up[t&1], &rd[t&1], t, n);
+			#pragma omp section
+			{
+				if(t+1 < n)
+					scatter(&up[(t+1)&1], &jobs[t+1], planes);
+				if(t >= 3)
+					gather(&rd[(t+1)&1], &jobs[t-3], planes);
+			}
+		}
+	}
+	/* the last job came back in the last step */
+	if(ok)
+		gather(&rd[(n+1)&1], &jobs[n-1], planes);
+	for(t=0;t<2;t++){
+		if(z != NULL){
+			z->raw += up[t].raw;
+			z->sent += up[t].sent;
+		}
+		free(up[t].data);
+		free(up[t].coded);
+		free(rd[t].data);
+	}
+	return ok;
+}
+
+int pipeline_run_boards(FPGA *boards, int nb, const PIPE_JOB *jobs, long n, int planes, long *done,
+		PIPE_CODING *z)
+{
+	PIPE_CODING part[FPGA_BOARDS_MAX];
+	long next = 0;
+	int b, ok = 1;
+
+	if(done != NULL)
+		for(b=0;b<nb;b++)
+			done[b] = 0;
+	if(nb == 1){
+		/* one pipeline, without a refill every PIPE_SHARD jobs */
+		if(done != NULL)
+			done[0] = n;
+		return pipeline_run(boards, jobs, n, planes, z);
+	}
+#ifdef _OPENMP
+	/* the pipeline of each board has its own threads */
+	omp_set_max_active_levels(2);
+#endif
+	for(b=0;b<nb;b++)
+		part[b].raw = part[b].sent = 0;
+	#pragma omp parallel num_threads(nb) private(b) reduction(&&:ok)
+	{
+		long first, m;
+#ifdef _OPENMP
+		b = omp_get_thread_num();
+#else
+		b = 0;
+#endif
+		for(;;){
+			#pragma omp atomic capture
+			{ first = next; next += PIPE_SHARD; }
+			if(first >= n)
+				break;
+			m = n - first < PIPE_SHARD ? n - first : PIPE_SHARD;
+			if(!pipeline_run(&boards[b], jobs + first, m, planes, z != NULL ? &part[b] : NULL)){
+				ok = 0;
+				break;
+			}
+			if(done != NULL)
+				done[b] += m;
+		}
+	}
+	if(z != NULL)
+		for(b=0;b<nb;b++){
+			z->raw += part[b].raw;
+			z->sent += part[b].sent;
+		}
+	return ok;
+}
+
+int pipeline_lowpass(FPGA *boards, int nb, const IMAGE *in, IMAGE *out, int n, const ROI *roi, int planes,
+		long *done, PIPE_CODING *z)
+{
+	PIPE_JOB *jobs;
+	ROI r, win;
+	long tiles, t;
+	int i, w, h, ok;
+
+	if(n < 1 || !roi_clip(roi, in[0].H, in[0].W, &r))
+		return 1;
+	roi_halo(&r, in[0].H, in[0].W, &win);
+	pipeline_tile_size(&win, &w, &h);
+	tiles = pipeline_tiles(&r, in[0].H, in[0].W, w, h, NULL);
+	jobs = (PIPE_JOB *)malloc(n*tiles*sizeof(PIPE_JOB));
+	if(jobs == NULL){
+		boards[0].error = "out of memory";
+		return 0;
+	}
+	for(i=0;i<n;i++){
+		pipeline_tiles(&r, in[0].H, in[0].W, w, h, jobs + i*tiles);
+		for(t=0;t<tiles;t++){
+			jobs[i*tiles+t].in = &in[i];
+			jobs[i*tiles+t].out = &out[i];
+		}
+	}
+	ok = pipeline_run_boards(boards, nb, jobs, n*tiles, planes, done, z);
+	free(jobs);
+	return ok;
+}
+
+void pipeline_set_shape(const PIPE_SHAPE *s)
+{
+	shape = *s;
+	if(shape.order < 0 || shape.order >= PIPE_ORDERS)
+		shape.order = PIPE_ORDER_PLANE;
+}
+
+void pipeline_get_shape(PIPE_SHAPE *s)
+{
+	*s = shape;
+}
+
+const char *pipeline_order_name(int order)
+{
+	return order >= 0 && order < PIPE_ORDERS ? order_names[order] : "?";
+}
+
+int pipeline_shape_load(const char *file, PIPE_SHAPE *s)
+{
+	FILE *f = fopen(file, "r");
+	char key[16], value[32];
+	int k, ok = 0;
+
+	if(f == NULL)
+		return 0;
+	s->chunk = 0;
+	s->order = PIPE_ORDER_PLANE;
+	while(fscanf(f, "%15s %31s", key, value) == 2){
+		if(strcmp(key, "chunk") == 0)
+			s->chunk = (size_t)strtoul(value, NULL, 10);
+		else if(strcmp(key, "order") == 0)
+			for(k=0;k<PIPE_ORDERS;k++)
+				if(strcmp(value, order_names[k]) == 0)
+					s->order = k;
+		ok = 1;
+	}
+	fclose(f);
+	return ok;
+}
+
+int pipeline_shape_save(const char *file, const PIPE_SHAPE *s)
+{
+	FILE *f = fopen(file, "w");
+	if(f == NULL)
+		return 0;
+	fprintf(f, "chunk %lu\norder %s\n", (unsigned long)s->chunk, pipeline_order_name(s->order));
+	return fclose(f) == 0;
+}
+
+/* seconds and bytes of every transfer of the boards so far */
+static double link_time(const FPGA *boards, int nb, double *bytes)
+{
+	double t = 0;
+	int b, p;
+	*bytes = 0;
+	for(b=0;b<nb;b++)
+		for(p=0;p<FPGA_PHASES;p++){
+			t += boards[b].stats.phase_time[p];
+			*bytes += (double)boards[b].stats.phase_bytes[p];
+		}
+	return t;
+}
+
+int pipeline_autotune(FPGA *boards, int nb, const IMAGE *in, IMAGE *out, int n, const ROI *roi, int planes,
+		PIPE_CODING *z, PIPE_TUNE *tune)
+{
+	/* a phase has at most PIPE_BANK_DEPTH bytes, larger chunks are whole
+	 * phases */
+	static const size_t chunks[] = { 0, 2048, 1024, 512, 256, 128, 64 };
+	PIPE_SHAPE s;
+	double t0, t1, b0, b1;
+	int c, o, r, count = 0, best = 0;
+
+	for(c=0;c<(int)(sizeof(chunks)/sizeof(chunks[0]));c++)
+		for(o=0;o<PIPE_ORDERS && count<PIPE_TUNE_MAX;o++){
+			PIPE_TUNE *t = &tune[count];
+			/* interleaving whole phases is the plane order */
+			if(chunks[c] == 0 && o == PIPE_ORDER_INTERLEAVE)
+				continue;
+			s.chunk = chunks[c];
+			s.order = o;
+			pipeline_set_shape(&s);
+			t->shape = s;
+			t->seconds = -1;
+			for(r=0;r<PIPE_TUNE_RUNS;r++){
+				t0 = link_time(boards, nb, &b0);
+				if(!pipeline_lowpass(boards, nb, in, out, n, roi, planes, NULL, z))
+					return 0;
+				t1 = link_time(boards, nb, &b1);
+				if(t->seconds < 0 || t1 - t0 < t->seconds){
+					t->seconds = t1 - t0;
+					t->rate = t1 > t0 ? (b1 - b0) / (t1 - t0) : 0;
+				}
+			}
+			if(t->seconds < tune[best].seconds)
+				best = count;
+			count++;
+		}
+	pipeline_set_shape(&tune[best].shape);
+	return count;
+}
@@ -0,0 +1,118 @@
+/* Low-pass of a sequence of frames on the fabric of top_level_27.vhdl,
+ * using its two BRAM banks in turn. The host reads job t-2 back from the
+ * output BRAMs, starts the fabric on job t-1 in one bank and uploads job
+ * t into the other one while it filters, so the link stays busy instead
+ * of waiting for the filter. The CPU scatters job t+1 and gathers job
+ * t-3 at the same time on another thread.
+ * A job is a frame, or a tile of it when the phases of the frame do not
+ * fit a bank. Tiles all have the same window, overlap by the two-pixel
+ * halo and only their inner pixels are written back.
+ * With several boards each one runs its own pipeline and takes the next
+ * PIPE_SHARD jobs from a shared queue whenever its own run out, so a
+ * faster board ends up with more of the work.
+ * The uploads may go delta/run-length coded (deltarle.h), the scatter
+ * thread codes job t+1 as well and the fabric decodes it.
+ * How the phases go over the link, in chunks and in which order, is a
+ * PIPE_SHAPE. pipeline_autotune times the shapes worth trying on the
+ * board and keeps the fastest.
+ */
+
+#ifndef FPGA_PIPELINE_H
+#define FPGA_PIPELINE_H
+
+#include <stddef.h>
+#include "image.h"
+#include "box_filter.h"
+#include "fpga_transport.h"
+
+#define PIPE_PHASES 3
+#define PIPE_BANK_CHAN 0x0e	/* bit 0 is the bank the host sees, a write rewinds the addresses */
+#define PIPE_UNBANKED 0x02	/* written to PIPE_BANK_CHAN, back to whole BRAMs */
+#define PIPE_FILTER_CHAN 0x10	/* selecting it filters the other bank */
+#define PIPE_BRAM_DEPTH 8192	/* bytes of a phase BRAM */
+#define PIPE_BANK_DEPTH 4096	/* bytes of a phase in one bank */
+#define PIPE_SHARD 8		/* jobs a board takes from the queue at a time */
+#define PIPE_CODING_CHAN 0x0d	/* bit 0 decodes the phase uploads */
+#define PIPE_OUT_CHAN 0x31	/* output BRAM of blue, green and red follow */
+#define PIPE_OUT_DEPTH 65536	/* bytes of an output BRAM */
+#define PIPE_REWIND_CHAN 0	/* rewinds the read and output addresses */
+#define PIPE_WIDTH_CHAN 0x0b	/* last column of the window the filter runs over */
+#define PIPE_HEIGHT_CHAN 0x0c	/* last row of it */
+#define PIPE_WINDOW_MAX 256	/* longest side the two registers hold */
+
+#define PIPE_ORDER_PLANE 0	/* every phase of blue, then of green and red */
+#define PIPE_ORDER_PHASE 1	/* phase p of every plane, then phase p+1 */
+#define PIPE_ORDER_INTERLEAVE 2	/* chunk c of every phase, then chunk c+1 */
+#define PIPE_ORDERS 3
+#define PIPE_TUNE_RUNS 3	/* runs of a shape, the fastest one counts */
+#define PIPE_TUNE_MAX 32	/* shapes pipeline_autotune tries */
+
+typedef struct PIPE_JOB{
+	const IMAGE *in;
+	IMAGE *out;
+	ROI roi;		/* pixels written to out */
+	ROI win;		/* roi and its halo, the same size for all jobs */
+}PIPE_JOB;
+
+/* bytes of the phase uploads before and after coding */
+typedef struct PIPE_CODING{
+	size_t raw;
+	size_t sent;
+}PIPE_CODING;
+
+/* transfers of at most chunk bytes (0 for one per phase) in a PIPE_ORDER_*.
+ * Coded uploads keep the chunks of a phase together whatever the order,
+ * the fabric restarts the decoder when the channel changes */
+typedef struct PIPE_SHAPE{
+	size_t chunk;
+	int order;
+}PIPE_SHAPE;
+
+typedef struct PIPE_TUNE{
+	PIPE_SHAPE shape;
+	double seconds;		/* in transfers, the fastest run */
+	double rate;		/* bytes per second over the link */
+}PIPE_TUNE;
+
+/* the shape of the transfers of every later run, one transfer per phase
+ * in plane order until it is set */
+void pipeline_set_shape(const PIPE_SHAPE *s);
+void pipeline_get_shape(PIPE_SHAPE *s);
+const char *pipeline_order_name(int order);
+/* a shape as the text "chunk <bytes>" and "order <name>", the saved one of
+ * pipeline_autotune. Return 1 on success */
+int pipeline_shape_load(const char *file, PIPE_SHAPE *s);
+int pipeline_shape_save(const char *file, const PIPE_SHAPE *s);
+
+/* 1 when every phase of win fits depth bytes and the fabric can be set
+ * to its size */
+int pipeline_fits(const ROI *win, size_t depth);
+/* window size of the tiles of win, the largest whose phases fit a bank
+ * with sides up to PIPE_WINDOW_MAX */
+void pipeline_tile_size(const ROI *win, int *w, int *h);
+/* jobs for the tiles of roi (already clipped) in an H x W frame with
+ * tiles of w x h, returns their number. jobs may be NULL to count them */
+long pipeline_tiles(const ROI *roi, int H, int W, int w, int h, PIPE_JOB *jobs);
+
+/* run n jobs through the banks with the planes in mask. The uploads are
+ * coded when z is not NULL, their bytes are added to it. Returns 1 on
+ * success, else 0 with f->error set */
+int pipeline_run(FPGA *f, const PIPE_JOB *jobs, long n, int planes, PIPE_CODING *z);
+/* the same spread over nb boards, each one on its own thread. done[b],
+ * if not NULL, counts the jobs of board b. Returns 0 when a board failed,
+ * its error is set */
+int pipeline_run_boards(FPGA *boards, int nb, const PIPE_JOB *jobs, long n, int planes, long *done,
+		PIPE_CODING *z);
+/* filter roi (NULL for the whole frame) of n frames of the same size on
+ * nb boards, in tiles when needed. The roi pixels of out[i] are replaced
+ * by the result, the rest of out[i] is not touched */
+int pipeline_lowpass(FPGA *boards, int nb, const IMAGE *in, IMAGE *out, int n, const ROI *roi, int planes,
+		long *done, PIPE_CODING *z);
+/* pipeline_lowpass PIPE_TUNE_RUNS times with every shape worth trying,
+ * timed by the transfer statistics of the boards, and set the fastest.
+ * The shapes and their times go to tune, at most PIPE_TUNE_MAX. Returns
+ * their number, 0 when a run failed */
+int pipeline_autotune(FPGA *boards, int nb, const IMAGE *in, IMAGE *out, int n, const ROI *roi, int planes,
+		PIPE_CODING *z, PIPE_TUNE *tune);
+
+#endif
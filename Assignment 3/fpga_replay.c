@@ -0,0 +1,216 @@
+/* Backend that plays a trace of fpga_record back instead of a board, so
+ * changes to the host side can be timed without hardware. The device is
+ * "trace[@speed]": each transfer takes its recorded time divided by speed
+ * (1 when not given, 0 does not wait at all), scaled by its length when
+ * that differs from the recorded one. The recorded reads of a channel are
+ * one stream of bytes, and so are its writes: a transfer takes the next n
+ * bytes of its stream with their share of the recorded time. The host
+ * thus sees what the board sent even when it now splits or orders its
+ * transfers differently, as with another -S chunk size. Writes are only
+ * timed, bytes past the recorded ones at the average write rate.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "fpga_transport.h"
+
+typedef struct REPLAY_REC{
+	int kind, chan;
+	size_t n;
+	double t;		/* recorded duration, seconds */
+	long data;		/* offset of the bytes in the trace */
+}REPLAY_REC;
+
+typedef struct REPLAY{
+	unsigned char *trace;
+	REPLAY_REC *rec;
+	long count;
+	long next[2][FPGA_CHANNELS];	/* write and read record of a channel */
+	size_t off[2][FPGA_CHANNELS];	/* bytes of it already taken */
+	double speed;
+	double write_rate;	/* bytes per second of all recorded writes */
+	long reads, writes, resized;
+	double waited;
+}REPLAY;
+
+static unsigned long get32(const unsigned char *p)
+{
+	return p[0] | (unsigned long)p[1] << 8 | (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+static void replay_sleep(double t)
+{
+	if(t <= 0)
+		return;
+#ifdef _WIN32
+	Sleep((DWORD)(t * 1e3));
+#else
+	{
+		struct timespec ts;
+		ts.tv_sec = (time_t)t;
+		ts.tv_nsec = (long)((t - ts.tv_sec) * 1e9);
+		nanosleep(&ts, NULL);
+	}
+#endif
+}
+
+static void replay_wait(REPLAY *r, double t)
+{
+	if(r->speed <= 0)
+		return;
+	r->waited += t / r->speed;
+	replay_sleep(t / r->speed);
+}
+
+/* the next n bytes of the kind records on chan into data, unless it is
+ * NULL. Returns how many the trace still had, *t is their share of the
+ * recorded time and *whole 1 when they were exactly one record */
+static size_t replay_take(REPLAY *r, int kind, int chan, unsigned char *data, size_t n,
+		double *t, int *whole)
+{
+	long *i = &r->next[kind == 'R'][chan];
+	size_t *o = &r->off[kind == 'R'][chan], got = 0;
+
+	*t = 0;
+	*whole = n == 0;
+	while(got < n){
+		const REPLAY_REC *rec;
+		size_t m;
+		while(*i < r->count && (r->rec[*i].kind != kind || r->rec[*i].chan != chan))
+			(*i)++;
+		if(*i == r->count)
+			break;
+		rec = &r->rec[*i];
+		if(got == 0)
+			*whole = *o == 0 && rec->n == n;
+		m = rec->n - *o < n - got ? rec->n - *o : n - got;
+		if(data != NULL)
+			memcpy(data + got, r->trace + rec->data + *o, m);
+		*t += rec->n > 0 ? rec->t * m / rec->n : rec->t;
+		got += m;
+		*o += m;
+		if(*o == rec->n){
+			(*i)++;
+			*o = 0;
+		}
+	}
+	return got;
+}
+
+static int replay_open(void **ctx, const char *device, const char **error)
+{
+	REPLAY *r = (REPLAY *)calloc(1, sizeof(REPLAY));
+	char file[FPGA_NAME_LEN*4];
+	const char *at = strrchr(device, '@');
+	size_t size = 0, o, written = 0;
+	double write_time = 0;
+	long cap = 0;
+	FILE *f;
+
+	if(r == NULL){
+		*error = "out of memory";
+		return 0;
+	}
+	r->speed = at ? atof(at + 1) : 1;
+	snprintf(file, sizeof(file), "%.*s", at ? (int)(at - device) : (int)strlen(device), device);
+	f = fopen(file, "rb");
+	if(f != NULL){
+		fseek(f, 0, SEEK_END);
+		size = (size_t)ftell(f);
+		fseek(f, 0, SEEK_SET);
+		r->trace = (unsigned char *)malloc(size ? size : 1);
+		if(r->trace == NULL || fread(r->trace, 1, size, f) != size)
+			size = 0;
+		fclose(f);
+	}
+	if(size < 4 || memcmp(r->trace, FPGA_TRACE_MAGIC, 4) != 0){
+		free(r->trace);
+		free(r);
+		*error = "cannot read the trace";
+		return 0;
+	}
+	for(o=4;o+FPGA_TRACE_HEAD<=size;){
+		REPLAY_REC *rec;
+		if(r->count == cap){
+			REPLAY_REC *more = (REPLAY_REC *)realloc(r->rec, (cap ? 2*cap : 1024)*sizeof(REPLAY_REC));
+			if(more == NULL)
+				break;
+			r->rec = more;
+			cap = cap ? 2*cap : 1024;
+		}
+		rec = &r->rec[r->count];
+		rec->kind = r->trace[o];
+		rec->chan = r->trace[o+1] % FPGA_CHANNELS;
+		rec->n = get32(r->trace + o + 2);
+		rec->t = get32(r->trace + o + 10) * 1e-6;
+		rec->data = (long)(o + FPGA_TRACE_HEAD);
+		if(rec->n > size - o - FPGA_TRACE_HEAD)
+			break;	/* cut short, the rest is lost */
+		o += FPGA_TRACE_HEAD + rec->n;
+		if(rec->kind == 'W'){
+			written += rec->n;
+			write_time += rec->t;
+		}
+		r->count++;
+	}
+	r->write_rate = write_time > 0 ? written / write_time : 0;
+	*ctx = r;
+	return 1;
+}
+
+static int replay_write(void *ctx, int chan, const unsigned char *data, size_t n, const char **error)
+{
+	REPLAY *r = (REPLAY *)ctx;
+	double t;
+	int whole;
+	size_t got = replay_take(r, 'W', chan, NULL, n, &t, &whole);
+	(void)data;
+	(void)error;
+	r->writes++;
+	if(!whole)
+		r->resized++;
+	/* the host sends more than it did, a coded upload say */
+	if(got < n && r->write_rate > 0)
+		t += (n - got) / r->write_rate;
+	replay_wait(r, t);
+	return 1;
+}
+
+static int replay_read(void *ctx, int chan, unsigned char *data, size_t n, const char **error)
+{
+	REPLAY *r = (REPLAY *)ctx;
+	double t;
+	int whole;
+	size_t got = replay_take(r, 'R', chan, data, n, &t, &whole);
+
+	if(got == 0 && n > 0){
+		*error = "the trace has no more reads on this channel";
+		return 0;
+	}
+	/* the host reads more than the board sent, the rest is zero */
+	memset(data + got, 0, n - got);
+	r->reads++;
+	if(!whole)
+		r->resized++;
+	replay_wait(r, got > 0 ? t * n / got : t);
+	return 1;
+}
+
+static void replay_close(void *ctx)
+{
+	REPLAY *r = (REPLAY *)ctx;
+	printf("replay: %ld writes, %ld reads, %ld of another length, %.3f ms waited\n",
+		r->writes, r->reads, r->resized, r->waited * 1e3);
+	free(r->rec);
+	free(r->trace);
+	free(r);
+}
+
+const FPGA_BACKEND fpga_replay_backend = { "replay", replay_open, replay_write, replay_read, replay_close, NULL, NULL, NULL };
@@ -0,0 +1,802 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#ifdef FPGALINK
+#include <libfpgalink.h>
+#endif
+
+#include "fpga_transport.h"
+#include "hexcodec.h"
+
+#ifdef FPGALINK
+static int fl_open(void **ctx, const char *device, const char **error)
+{
+	struct FLContext *handle = NULL;
+
+	flInitialise();
+	if(flOpen(device, &handle, error) != FL_SUCCESS)
+		return 0;
+	if(!flIsCommCapable(handle)){
+		*error = "device is not comm capable, is the design loaded?";
+		flClose(handle);
+		return 0;
+	}
+	*ctx = handle;
+	return 1;
+}
+
+static int fl_write(void *ctx, int chan, const unsigned char *data, size_t n, const char **error)
+{
+	return flWriteChannel((struct FLContext *)ctx, FPGA_TIMEOUT, (uint8)chan, (uint32)n, data, error) == FL_SUCCESS;
+}
+
+static int fl_read(void *ctx, int chan, unsigned char *data, size_t n, const char **error)
+{
+	return flReadChannel((struct FLContext *)ctx, FPGA_TIMEOUT, (uint8)chan, (uint32)n, data, error) == FL_SUCCESS;
+}
+
+static void fl_close(void *ctx)
+{
+	flClose((struct FLContext *)ctx);
+}
+
+#ifdef FPGALINK_ASYNC
+/* the library queues the writes and keeps the FX2 busy until the await */
+static int fl_write_batch(void *ctx, const FPGA_WRITE *w, int count, const char **error)
+{
+	int k;
+	for(k=0;k<count;k++)
+		if(flWriteChannelAsync((struct FLContext *)ctx, (uint8)w[k].chan, w[k].n, w[k].data, error) != FL_SUCCESS)
+			return 0;
+	return flAwaitAsyncWrites((struct FLContext *)ctx, error) == FL_SUCCESS;
+}
+
+/* all reads are in flight before the first await, the library fills the
+ * buffers directly. It takes at most 64KiB per submitted read. */
+static int fl_read_batch(void *ctx, const FPGA_READ *r, int count, const char **error)
+{
+	struct ReadReport report;
+	int k;
+	for(k=0;k<count;k++)
+		if(r[k].n > 0x10000){
+			for(k=0;k<count;k++)
+				if(!fl_read(ctx, r[k].chan, r[k].data, r[k].n, error))
+					return 0;
+			return 1;
+		}
+	for(k=0;k<count;k++)
+		if(flReadChannelAsyncSubmit((struct FLContext *)ctx, (uint8)r[k].chan, (uint32)r[k].n, r[k].data, error) != FL_SUCCESS)
+			return 0;
+	for(k=0;k<count;k++)
+		if(flReadChannelAsyncAwait((struct FLContext *)ctx, &report, error) != FL_SUCCESS)
+			return 0;
+	return 1;
+}
+
+#endif
+
+static int fl_available(const char *name)
+{
+	const char *error = NULL;
+	bool avail = 0;
+	flInitialise();
+	return flIsDeviceAvailable(name, &avail, &error) == FL_SUCCESS && avail;
+}
+
+/* boards of one VID:PID are told apart by their device ID, as VID:PID:DID
+ * with DID 1 and up. The bare VID:PID opens whichever board it finds, so
+ * it is only listed, as index 0, when no board answers with a DID */
+static int fl_enumerate(const char *device, int index, char *name)
+{
+	int i;
+
+	if(index > 0){
+		sprintf(name, "%s:%04x", device, index);
+		return fl_available(name);
+	}
+	for(i=1;i<FPGA_BOARDS_MAX;i++){
+		sprintf(name, "%s:%04x", device, i);
+		if(fl_available(name))
+			return 0;
+	}
+	strcpy(name, device);
+	return fl_available(name);
+}
+
+#ifdef FPGALINK_ASYNC
+static const FPGA_BACKEND fpgalink_backend = { "fpgalink", fl_open, fl_write, fl_read, fl_close, fl_write_batch, fl_read_batch, fl_enumerate };
+#else
+static const FPGA_BACKEND fpgalink_backend = { "fpgalink", fl_open, fl_write, fl_read, fl_close, NULL, NULL, fl_enumerate };
+#endif
+#endif
+
+/* the command line is built in place, the hex digits need 2*FLCLI_CHUNK
+ * and each action a few more characters. With a pipe the same actions go
+ * to one flcli -c as a line each, without the program and device */
+typedef struct FLCLI_CTX{
+	int session;		/* keeps the read files of boards apart */
+	char device[32];
+	FILE *pipe;		/* stdin of the flcli session, or NULL */
+	int fifos;		/* FIFOs made so far for the reads of a line */
+	char cmd[2*FLCLI_CHUNK + 16*(FPGA_BATCH_MAX+1) + 256];
+}FLCLI_CTX;
+
+/* FLCLI from the environment, else the one built in */
+static const char *flcli_path(void)
+{
+	const char *path = getenv("FLCLI");
+	return path != NULL && *path ? path : FLCLI;
+}
+
+static int cli_open(void **ctx, const char *device, const char **error)
+{
+	static int sessions;
+	FLCLI_CTX *c = (FLCLI_CTX *)calloc(1, sizeof(FLCLI_CTX));
+	if(c==NULL){
+		*error = "out of memory";
+		return 0;
+	}
+	c->session = sessions++;
+	strncpy(c->device, device, sizeof(c->device) - 1);
+	c->device[sizeof(c->device) - 1] = 0;
+	*ctx = c;
+	return 1;
+}
+
+/* start of the actions in cmd, returns its length */
+static int cli_start(FLCLI_CTX *c)
+{
+	if(c->pipe != NULL)
+		return 0;
+	return sprintf(c->cmd, "\"%s\" -v %s -a \"", flcli_path(), c->device);
+}
+
+/* run the actions in cmd, len includes the ';' after the last one */
+static int cli_run(FLCLI_CTX *c, int len, const char **error)
+{
+	if(c->pipe != NULL){
+		c->cmd[len-1] = '\n';
+		if(fwrite(c->cmd, 1, len, c->pipe) != (size_t)len || fflush(c->pipe) != 0){
+			*error = "flcli session ended";
+			return 0;
+		}
+		return 1;
+	}
+	c->cmd[len-1] = '"';
+	c->cmd[len] = 0;
+	if(system(c->cmd) != 0){
+		*error = "flcli write failed";
+		return 0;
+	}
+	return 1;
+}
+
+/* as many writes per flcli run as fit in FLCLI_CHUNK bytes, a longer
+ * write is split and the next command carries on where it stopped */
+static int cli_write_batch(void *ctx, const FPGA_WRITE *w, int count, const char **error)
+{
+	FLCLI_CTX *c = (FLCLI_CTX *)ctx;
+	size_t used = 0;
+	int k, base = cli_start(c), len = base;
+
+	for(k=0;k<count;k++){
+		size_t done = 0;
+		while(done < w[k].n){
+			size_t m = w[k].n - done;
+			if(used == FLCLI_CHUNK){
+				if(!cli_run(c, len, error))
+					return 0;
+				len = cli_start(c);
+				used = 0;
+			}
+			if(m > FLCLI_CHUNK - used)
+				m = FLCLI_CHUNK - used;
+			len += sprintf(c->cmd + len, "w%x ", w[k].chan);
+			len += (int)hex_encode(w[k].data + done, m, c->cmd + len);
+			c->cmd[len++] = ';';
+			used += m;
+			done += m;
+		}
+	}
+	return len == base || cli_run(c, len, error);
+}
+
+static int cli_write(void *ctx, int chan, const unsigned char *data, size_t n, const char **error)
+{
+	FPGA_WRITE w;
+	w.chan = chan;
+	w.data = data;
+	w.n = n;
+	return cli_write_batch(ctx, &w, 1, error);
+}
+
+#ifndef _WIN32
+/* read k of a line comes through its own FIFO, which flcli opens only
+ * after the one before, so the bytes of two reads cannot mix */
+static int pipe_read_fifo(FLCLI_CTX *c, int k, unsigned char *data, size_t n, const char **error)
+{
+	char name[64];
+	unsigned char spill;
+	struct pollfd p;
+	size_t got = 0;
+	ssize_t m;
+	int idle = 0;
+
+	sprintf(name, FLPIPE_FIFO, (int)getpid(), c->session, k);
+	p.fd = open(name, O_RDONLY | O_NONBLOCK);
+	p.events = POLLIN;
+	if(p.fd < 0){
+		*error = "cannot open the flcli FIFO";
+		return 0;
+	}
+	/* until flcli has written it all and closed its end, bytes beyond n
+	 * are dropped */
+	for(;;){
+		if(poll(&p, 1, FLPIPE_TIMEOUT) <= 0 || idle == FLPIPE_TIMEOUT){
+			*error = "flcli did not answer";
+			close(p.fd);
+			return 0;
+		}
+		m = got < n ? read(p.fd, data + got, n - got) : read(p.fd, &spill, 1);
+		if(m > 0 && got < n)
+			got += m;
+		else if(m == 0 && got < n){
+			/* some systems report the end before flcli has opened it */
+			struct timespec ts = {0, 1000000};
+			nanosleep(&ts, NULL);
+			idle++;
+		}
+		else if(m == 0 || (m < 0 && errno != EAGAIN && errno != EINTR))
+			break;
+	}
+	close(p.fd);
+	if(got < n){
+		*error = "flcli read was short";
+		return 0;
+	}
+	return 1;
+}
+#endif
+
+/* one run with a read action per buffer, each into its own file */
+static int cli_read_batch(void *ctx, const FPGA_READ *r, int count, const char **error)
+{
+	FLCLI_CTX *c = (FLCLI_CTX *)ctx;
+	char name[64];
+	int k, len, ok = 1;
+
+	if(count == 0)
+		return 1;
+	len = cli_start(c);
+	for(k=0;k<count;k++){
+#ifndef _WIN32
+		if(c->pipe != NULL){
+			sprintf(name, FLPIPE_FIFO, (int)getpid(), c->session, k);
+			if(k == c->fifos){
+				if(mkfifo(name, 0600) != 0 && errno != EEXIST){
+					*error = "cannot make the flcli FIFO";
+					return 0;
+				}
+				c->fifos++;
+			}
+		}
+		else
+#endif
+			sprintf(name, FLCLI_READ_FILE, c->session, k);
+		len += sprintf(c->cmd + len, c->pipe ? "r%x %lx \"%s\";" : "r%x %lx \\\"%s\\\";",
+			r[k].chan, (unsigned long)r[k].n, name);
+	}
+	if(c->pipe != NULL){
+#ifndef _WIN32
+		if(!cli_run(c, len, error))
+			return 0;
+		for(k=0;k<count && ok;k++)
+			ok = pipe_read_fifo(c, k, r[k].data, r[k].n, error);
+#endif
+		return ok;
+	}
+	c->cmd[len-1] = '"';
+	c->cmd[len] = 0;
+	if(system(c->cmd) != 0){
+		*error = "flcli read failed";
+		return 0;
+	}
+	for(k=0;k<count;k++){
+		FILE *f;
+		sprintf(name, FLCLI_READ_FILE, c->session, k);
+		f = fopen(name, "rb");
+		if(f == NULL || fread(r[k].data, 1, r[k].n, f) < r[k].n){
+			*error = "flcli read was short";
+			ok = 0;
+		}
+		if(f != NULL)
+			fclose(f);
+		remove(name);
+	}
+	return ok;
+}
+
+static int cli_read(void *ctx, int chan, unsigned char *data, size_t n, const char **error)
+{
+	FPGA_READ r;
+	r.chan = chan;
+	r.data = data;
+	r.n = n;
+	return cli_read_batch(ctx, &r, 1, error);
+}
+
+static void cli_close(void *ctx)
+{
+	free(ctx);
+}
+
+static const FPGA_BACKEND flcli_backend = { "flcli", cli_open, cli_write, cli_read, cli_close, cli_write_batch, cli_read_batch, NULL };
+
+#ifndef _WIN32
+/* flcli -c started once, its prompts go to /dev/null. When it dies, the
+ * writes fail instead of the host getting SIGPIPE */
+static int pipe_open(void **ctx, const char *device, const char **error)
+{
+	FLCLI_CTX *c;
+	if(!cli_open(ctx, device, error))
+		return 0;
+	signal(SIGPIPE, SIG_IGN);
+	c = (FLCLI_CTX *)*ctx;
+	sprintf(c->cmd, "\"%s\" -v %s -c > /dev/null", flcli_path(), c->device);
+	c->pipe = popen(c->cmd, "w");
+	if(c->pipe == NULL){
+		free(c);
+		*error = "cannot start flcli";
+		return 0;
+	}
+	return 1;
+}
+
+static void pipe_close(void *ctx)
+{
+	FLCLI_CTX *c = (FLCLI_CTX *)ctx;
+	char name[64];
+	int k;
+
+	fputs("q\n", c->pipe);
+	pclose(c->pipe);
+	for(k=0;k<c->fifos;k++){
+		sprintf(name, FLPIPE_FIFO, (int)getpid(), c->session, k);
+		unlink(name);
+	}
+	free(c);
+}
+
+static const FPGA_BACKEND flpipe_backend = { "flcli-pipe", pipe_open, cli_write, cli_read, pipe_close, cli_write_batch, cli_read_batch, NULL };
+#endif
+
+/* the stand-in keeps the last write of every channel */
+typedef struct LOOPBACK{
+	unsigned char *data[FPGA_CHANNELS];
+	size_t len[FPGA_CHANNELS];
+}LOOPBACK;
+
+static int lb_open(void **ctx, const char *device, const char **error)
+{
+	LOOPBACK *lb = (LOOPBACK *)calloc(1, sizeof(LOOPBACK));
+	(void)device;
+	if(lb==NULL){
+		*error = "out of memory";
+		return 0;
+	}
+	*ctx = lb;
+	return 1;
+}
+
+static int lb_write(void *ctx, int chan, const unsigned char *data, size_t n, const char **error)
+{
+	LOOPBACK *lb = (LOOPBACK *)ctx;
+	unsigned char *p = (unsigned char *)realloc(lb->data[chan], n ? n : 1);
+	if(p==NULL){
+		*error = "out of memory";
+		return 0;
+	}
+	memcpy(p, data, n);
+	lb->data[chan] = p;
+	lb->len[chan] = n;
+	return 1;
+}
+
+static int lb_read(void *ctx, int chan, unsigned char *data, size_t n, const char **error)
+{
+	LOOPBACK *lb = (LOOPBACK *)ctx;
+	size_t m;
+	(void)error;
+	memset(data, 0, n);
+	if(n==0)
+		return 1;
+	/* like a BRAM read, the first byte is stale */
+	m = lb->len[chan] < n - 1 ? lb->len[chan] : n - 1;
+	if(m)
+		memcpy(data + 1, lb->data[chan], m);
+	return 1;
+}
+
+static void lb_close(void *ctx)
+{
+	LOOPBACK *lb = (LOOPBACK *)ctx;
+	int c;
+	for(c=0;c<FPGA_CHANNELS;c++)
+		free(lb->data[c]);
+	free(lb);
+}
+
+/* software boards, as many as asked for */
+static int lb_enumerate(const char *device, int index, char *name)
+{
+	(void)index;
+	strcpy(name, device);
+	return 1;
+}
+
+static const FPGA_BACKEND loopback_backend = { "loopback", lb_open, lb_write, lb_read, lb_close, NULL, NULL, lb_enumerate };
+
+static const FPGA_BACKEND *backends[] = {
+#ifdef FPGALINK
+	&fpgalink_backend,
+#endif
+	&flcli_backend,
+#ifndef _WIN32
+	&flpipe_backend,
+#endif
+	&loopback_backend,
+#ifdef FPGA_EMULATOR
+	&fpga_emulator_backend,
+#endif
+	&fpga_replay_backend,
+};
+
+static const FPGA_BACKEND *find_backend(const char *backend)
+{
+	size_t b;
+	if(backend==NULL)
+		backend = fpga_default_backend();
+	for(b=0;b<sizeof(backends)/sizeof(backends[0]);b++)
+		if(strcmp(backends[b]->name, backend)==0)
+			return backends[b];
+	return NULL;
+}
+
+const char *fpga_default_backend(void)
+{
+#if defined(FPGALINK)
+	return "fpgalink";
+#elif defined(FPGA_EMULATOR)
+	return "emulator";
+#else
+	return "loopback";
+#endif
+}
+
+/* monotonic seconds */
+static double clock_now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER c, freq;
+	QueryPerformanceCounter(&c);
+	QueryPerformanceFrequency(&freq);
+	return (double)c.QuadPart / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* one transfer of t seconds, the bytes are booked per channel by the caller */
+static void account(FPGA *f, size_t bytes, double t)
+{
+	FPGA_STATS *s = &f->stats;
+	double us = t * 1e6;
+	int b = 0;
+
+	while(us >= 2 && b < FPGA_HIST_BUCKETS-1){
+		us /= 2;
+		b++;
+	}
+	s->hist[b]++;
+	s->phase_time[s->phase] += t;
+	s->phase_bytes[s->phase] += bytes;
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+/* one transfer into the trace, start is a clock_now() */
+static void record(FPGA *f, int kind, int chan, const unsigned char *data, size_t n, double start, double t)
+{
+	unsigned char head[FPGA_TRACE_HEAD];
+	if(f->trace == NULL)
+		return;
+	head[0] = (unsigned char)kind;
+	head[1] = (unsigned char)chan;
+	put32(head + 2, (unsigned long)n);
+	put32(head + 6, (unsigned long)((start - f->trace_start) * 1e6));
+	put32(head + 10, (unsigned long)(t * 1e6));
+	fwrite(head, 1, sizeof(head), f->trace);
+	fwrite(data, 1, n, f->trace);
+}
+
+int fpga_record(FPGA *f, const char *file)
+{
+	f->trace = fopen(file, "wb");
+	if(f->trace == NULL){
+		f->error = "cannot write the trace";
+		return 0;
+	}
+	fwrite(FPGA_TRACE_MAGIC, 1, 4, f->trace);
+	f->trace_start = clock_now();
+	return 1;
+}
+
+int fpga_open(FPGA *f, const char *backend, const char *device)
+{
+	memset(f, 0, sizeof(*f));
+	f->stats.opened = clock_now();
+	f->ops = find_backend(backend);
+	if(f->ops==NULL){
+		f->error = "unknown backend";
+		return 0;
+	}
+	if(!f->ops->open(&f->ctx, device ? device : FPGA_DEVICE, &f->error)){
+		f->ops = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+int fpga_enumerate(const char *backend, const char *device, char names[][FPGA_NAME_LEN], int max)
+{
+	const FPGA_BACKEND *ops = find_backend(backend);
+	int i, n = 0;
+
+	if(ops==NULL)
+		return 0;
+	if(device==NULL)
+		device = FPGA_DEVICE;
+	if(strlen(device) >= FPGA_NAME_LEN - 8)
+		return -1;	/* room for the DID of fl_enumerate */
+	if(ops->enumerate==NULL){
+		if(max < 1)
+			return 0;
+		strcpy(names[0], device);
+		return 1;
+	}
+	for(i=0;i<FPGA_BOARDS_MAX && n<max;i++)
+		if(ops->enumerate(device, i, names[n]))
+			n++;
+	return n;
+}
+
+int fpga_design_is(FPGA *f, const char *id)
+{
+	unsigned char got[FPGA_ID_LEN];
+	return fpga_read(f, FPGA_ID_CHAN, got, FPGA_ID_LEN) && memcmp(got, id, FPGA_ID_LEN)==0;
+}
+
+int fpga_open_design(FPGA *f, const char *backend, const char *device, const char *id, const char *program)
+{
+	if(!fpga_open(f, backend, device))
+		return 0;
+	if(fpga_design_is(f, id) || program==NULL)
+		return 1;
+	fpga_close(f);
+	if(system(program) != 0){
+		f->error = "cannot load the design";
+		return 0;
+	}
+	if(!fpga_open(f, backend, device))
+		return 0;
+	/* the loader may have gone to another board or loaded another file */
+	if(!fpga_design_is(f, id)){
+		fpga_close(f);
+		f->error = "the loaded design is not the expected one";
+		return 0;
+	}
+	return 2;
+}
+
+int fpga_write(FPGA *f, int chan, const unsigned char *data, size_t n)
+{
+	double t, end;
+	int ok;
+
+	if(chan<0 || chan>=FPGA_CHANNELS){
+		f->error = "channel out of range";
+		return 0;
+	}
+	t = clock_now();
+	ok = f->ops->write(f->ctx, chan, data, n, &f->error);
+	end = clock_now();
+	f->stats.to_board[chan] += n;
+	f->stats.transfers[chan]++;
+	account(f, n, end - t);
+	if(ok)
+		record(f, 'W', chan, data, n, t, end - t);
+	return ok;
+}
+
+int fpga_read(FPGA *f, int chan, unsigned char *data, size_t n)
+{
+	double t, end;
+	int ok;
+
+	if(chan<0 || chan>=FPGA_CHANNELS){
+		f->error = "channel out of range";
+		return 0;
+	}
+	t = clock_now();
+	ok = f->ops->read(f->ctx, chan, data, n, &f->error);
+	end = clock_now();
+	f->stats.from_board[chan] += n;
+	f->stats.transfers[chan]++;
+	account(f, n, end - t);
+	if(ok)
+		record(f, 'R', chan, data, n, t, end - t);
+	return ok;
+}
+
+void fpga_close(FPGA *f)
+{
+	if(f->ops!=NULL)
+		f->ops->close(f->ctx);
+	if(f->trace!=NULL)
+		fclose(f->trace);
+	f->trace = NULL;
+	f->ops = NULL;
+	f->ctx = NULL;
+}
+
+void fpga_batch_init(FPGA_BATCH *b)
+{
+	b->count = 0;
+}
+
+int fpga_batch_add(FPGA_BATCH *b, int chan, const unsigned char *data, size_t n)
+{
+	if(b->count == FPGA_BATCH_MAX)
+		return 0;
+	b->w[b->count].chan = chan;
+	b->w[b->count].data = data;
+	b->w[b->count].n = n;
+	b->count++;
+	return 1;
+}
+
+int fpga_batch_flush(FPGA *f, FPGA_BATCH *b)
+{
+	double t = clock_now(), end;
+	size_t bytes = 0;
+	int k, ok = 1;
+	for(k=0;k<b->count && ok;k++)
+		if(b->w[k].chan<0 || b->w[k].chan>=FPGA_CHANNELS){
+			f->error = "channel out of range";
+			ok = 0;
+		}
+	if(!ok){
+		b->count = 0;
+		return 0;
+	}
+	if(f->ops->write_batch != NULL)
+		ok = f->ops->write_batch(f->ctx, b->w, b->count, &f->error);
+	else
+		for(k=0;k<b->count && ok;k++)
+			ok = f->ops->write(f->ctx, b->w[k].chan, b->w[k].data, b->w[k].n, &f->error);
+	for(k=0;k<b->count;k++){
+		f->stats.to_board[b->w[k].chan] += b->w[k].n;
+		f->stats.transfers[b->w[k].chan]++;
+		bytes += b->w[k].n;
+	}
+	end = clock_now();
+	account(f, bytes, end - t);
+	/* the time of the batch shared by the bytes of its writes */
+	for(k=0;k<b->count && ok && f->trace;k++){
+		double share = bytes ? (end - t) * b->w[k].n / bytes : 0;
+		record(f, 'W', b->w[k].chan, b->w[k].data, b->w[k].n, t, share);
+		t += share;
+	}
+	b->count = 0;
+	return ok;
+}
+
+int fpga_read_batch(FPGA *f, const FPGA_READ *r, int count)
+{
+	double t = clock_now(), end;
+	size_t bytes = 0;
+	int k, ok = 1;
+	if(count > FPGA_BATCH_MAX){
+		f->error = "too many reads in a batch";
+		return 0;
+	}
+	for(k=0;k<count;k++)
+		if(r[k].chan<0 || r[k].chan>=FPGA_CHANNELS){
+			f->error = "channel out of range";
+			return 0;
+		}
+	if(f->ops->read_batch != NULL)
+		ok = f->ops->read_batch(f->ctx, r, count, &f->error);
+	else
+		for(k=0;k<count && ok;k++)
+			ok = f->ops->read(f->ctx, r[k].chan, r[k].data, r[k].n, &f->error);
+	for(k=0;k<count;k++){
+		f->stats.from_board[r[k].chan] += r[k].n;
+		f->stats.transfers[r[k].chan]++;
+		bytes += r[k].n;
+	}
+	end = clock_now();
+	account(f, bytes, end - t);
+	for(k=0;k<count && ok && f->trace;k++){
+		double share = bytes ? (end - t) * r[k].n / bytes : 0;
+		record(f, 'R', r[k].chan, r[k].data, r[k].n, t, share);
+		t += share;
+	}
+	return ok;
+}
+
+void fpga_phase(FPGA *f, int phase)
+{
+	f->stats.phase = phase;
+}
+
+static const char *phase_names[FPGA_PHASES] = { "other", "upload", "compute", "readback" };
+
+static double mbps(unsigned long long bytes, double t)
+{
+	return t > 0 ? bytes / t / 1e6 : 0;
+}
+
+void fpga_stats_json(const FPGA *boards, int n, FILE *out)
+{
+	double now = clock_now();
+	int i, p, c, first;
+
+	fprintf(out, "{\"boards\": [");
+	for(i=0;i<n;i++){
+		const FPGA_STATS *s = &boards[i].stats;
+		unsigned long long bytes = 0;
+		double busy = 0;
+		for(p=0;p<FPGA_PHASES;p++){
+			busy += s->phase_time[p];
+			bytes += s->phase_bytes[p];
+		}
+		fprintf(out, "%s\n  {\"backend\": \"%s\", \"open_s\": %.6f, \"busy_s\": %.6f, \"bytes\": %llu, \"MBps\": %.3f,",
+			i ? "," : "", boards[i].ops ? boards[i].ops->name : "", now - s->opened, busy, bytes, mbps(bytes, busy));
+		fprintf(out, "\n   \"phases\": {");
+		for(p=0;p<FPGA_PHASES;p++)
+			fprintf(out, "%s\"%s\": {\"s\": %.6f, \"bytes\": %llu, \"MBps\": %.3f}", p ? ", " : "",
+				phase_names[p], s->phase_time[p], s->phase_bytes[p], mbps(s->phase_bytes[p], s->phase_time[p]));
+		fprintf(out, "},\n   \"latency_us_log2\": [");
+		for(p=0;p<FPGA_HIST_BUCKETS;p++)
+			fprintf(out, "%s%lu", p ? ", " : "", s->hist[p]);
+		fprintf(out, "],\n   \"channels\": [");
+		for(c=0,first=1;c<FPGA_CHANNELS;c++)
+			if(s->transfers[c]){
+				fprintf(out, "%s\n    {\"chan\": %d, \"transfers\": %lu, \"to_board\": %llu, \"from_board\": %llu}",
+					first ? "" : ",", c, s->transfers[c], s->to_board[c], s->from_board[c]);
+				first = 0;
+			}
+		fprintf(out, "]}");
+	}
+	fprintf(out, "\n]}\n");
+}
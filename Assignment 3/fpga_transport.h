@@ -0,0 +1,162 @@
+/* Channel transfers to the FPGA from inside the host program.
+ * The device is opened once and every write or read is a bulk transfer
+ * from or into a memory buffer, no scripts and no flcli processes.
+ * A backend supplies the four operations:
+ *   "fpgalink"  libfpgalink, when built with -DFPGALINK
+ *   "flcli"     one flcli run per transfer, for hosts without the library.
+ *               Writes go as hex arguments of at most FLCLI_CHUNK bytes,
+ *               reads come back through the files FLCLI_READ_FILE
+ *   "flcli-pipe"  one flcli -c for the whole session (not on Windows).
+ *               The same actions go down its stdin and reads come back
+ *               through the FIFOs FLPIPE_FIFO, nothing touches the disk
+ *   "loopback"  software stand-in, a read returns one stale byte and then
+ *               the bytes last written to the channel
+ *   "emulator"  model of top_level_27.vhdl in fpga_emulator.c, when built
+ *               with -DFPGA_EMULATOR. Filters the image like the board and
+ *               can model the USB link
+ *   "replay"    plays back a trace of fpga_record, see fpga_replay.c
+ */
+
+#ifndef FPGA_TRANSPORT_H
+#define FPGA_TRANSPORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define FPGA_DEVICE "1443:0007"	/* VID:PID of the board */
+#define FPGA_TIMEOUT 1000	/* ms per transfer */
+#define FPGA_CHANNELS 128
+
+#define FLCLI "C:/makestuff/libs/libfpgalink-20120621/win32/rel/flcli"	/* unless $FLCLI is set */
+#define FLCLI_CHUNK 8192	/* bytes per write command, keeps it below ARG_MAX */
+#define FLCLI_READ_FILE "flcli_read%d_%d.bin"	/* session and read of a run */
+#define FLPIPE_FIFO "/tmp/flcli%d_%d_%d"	/* process, session and read of a line */
+#define FLPIPE_TIMEOUT 10000	/* ms for flcli to answer a read */
+
+#define FPGA_BATCH_MAX 64	/* writes queued in one batch */
+#define FPGA_BOARDS_MAX 16	/* boards fpga_enumerate looks for */
+#define FPGA_NAME_LEN 256	/* device strings, trace paths of replay included */
+
+#define FPGA_ID_CHAN 0x7f	/* reads the design identity */
+#define FPGA_ID_LEN 4
+
+/* a trace starts with FPGA_TRACE_MAGIC, then per transfer the kind 'W' or
+ * 'R', the channel, and the length, start and duration in us since the
+ * recording began as 4 bytes little endian each, then the bytes */
+#define FPGA_TRACE_MAGIC "FTR1"
+#define FPGA_TRACE_HEAD 14	/* bytes of a transfer before its data */
+
+typedef struct FPGA_WRITE{
+	int chan;
+	const unsigned char *data;	/* must stay valid until the batch is sent */
+	size_t n;
+}FPGA_WRITE;
+
+typedef struct FPGA_READ{
+	int chan;
+	unsigned char *data;
+	size_t n;
+}FPGA_READ;
+
+/* writes sent as one transaction, see fpga_batch_flush */
+typedef struct FPGA_BATCH{
+	int count;
+	FPGA_WRITE w[FPGA_BATCH_MAX];
+}FPGA_BATCH;
+
+typedef struct FPGA_BACKEND{
+	const char *name;
+	/* the operations return 1 on success, else 0 with *error set */
+	int (*open)(void **ctx, const char *device, const char **error);
+	int (*write)(void *ctx, int chan, const unsigned char *data, size_t n, const char **error);
+	int (*read)(void *ctx, int chan, unsigned char *data, size_t n, const char **error);
+	void (*close)(void *ctx);
+	/* all writes of a batch in one stream, in order. NULL if the backend
+	 * has none, the writes are then sent one by one */
+	int (*write_batch)(void *ctx, const FPGA_WRITE *w, int count, const char **error);
+	/* the same for reads, at most FPGA_BATCH_MAX of them */
+	int (*read_batch)(void *ctx, const FPGA_READ *r, int count, const char **error);
+	/* name of board index of the kind device names into name, returns 0
+	 * when there is no such board. NULL if only device itself exists */
+	int (*enumerate)(const char *device, int index, char *name);
+}FPGA_BACKEND;
+
+/* what the host is doing, the time of its transfers is booked to it */
+#define FPGA_PHASE_OTHER 0
+#define FPGA_PHASE_UPLOAD 1
+#define FPGA_PHASE_COMPUTE 2	/* starting the fabric and waiting for it */
+#define FPGA_PHASE_READBACK 3
+#define FPGA_PHASES 4
+
+#define FPGA_HIST_BUCKETS 24	/* bucket b: transfers of 2^b to 2^(b+1) us */
+
+/* counters of every transfer, a clock read and a few additions each */
+typedef struct FPGA_STATS{
+	unsigned long long to_board[FPGA_CHANNELS], from_board[FPGA_CHANNELS];
+	unsigned long transfers[FPGA_CHANNELS];
+	unsigned long hist[FPGA_HIST_BUCKETS];
+	double phase_time[FPGA_PHASES];		/* seconds in transfers */
+	unsigned long long phase_bytes[FPGA_PHASES];
+	int phase;
+	double opened;				/* clock at fpga_open */
+}FPGA_STATS;
+
+typedef struct FPGA{
+	const FPGA_BACKEND *ops;
+	void *ctx;
+	const char *error;		/* last error, NULL if none */
+	FPGA_STATS stats;
+	FILE *trace;			/* transfers are recorded there, or NULL */
+	double trace_start;
+}FPGA;
+
+#ifdef FPGA_EMULATOR
+extern const FPGA_BACKEND fpga_emulator_backend;
+#endif
+extern const FPGA_BACKEND fpga_replay_backend;
+
+/* default backend name, fpgalink or else the emulator if built in */
+const char *fpga_default_backend(void);
+
+/* open device (NULL for FPGA_DEVICE) with the named backend, returns 1 on
+ * success, else 0 with f->error set */
+int fpga_open(FPGA *f, const char *backend, const char *device);
+/* names of at most max boards like device (NULL for FPGA_DEVICE) that the
+ * backend can reach, returns their number, or -1 when device is too long
+ * for a name */
+int fpga_enumerate(const char *backend, const char *device, char names[][FPGA_NAME_LEN], int max);
+/* 1 when the loaded design answers FPGA_ID_CHAN with the FPGA_ID_LEN
+ * bytes of id */
+int fpga_design_is(FPGA *f, const char *id);
+/* fpga_open, and when the design is not id run the shell command program,
+ * if not NULL, and open again. Loading a bitstream takes seconds, so it
+ * is only done when the board holds another design or none. Returns 2
+ * when the design was loaded and answers as id, 1 when it was there
+ * already, else 0 */
+int fpga_open_design(FPGA *f, const char *backend, const char *device, const char *id, const char *program);
+int fpga_write(FPGA *f, int chan, const unsigned char *data, size_t n);
+int fpga_read(FPGA *f, int chan, unsigned char *data, size_t n);
+/* record every following transfer of f into file until fpga_close, returns
+ * 0 when it cannot be written */
+int fpga_record(FPGA *f, const char *file);
+void fpga_close(FPGA *f);
+
+/* book the following transfers to phase, one of FPGA_PHASE_* */
+void fpga_phase(FPGA *f, int phase);
+/* the statistics of n boards as one JSON object, the boards must still
+ * be open */
+void fpga_stats_json(const FPGA *boards, int n, FILE *out);
+
+void fpga_batch_init(FPGA_BATCH *b);
+/* queue a write, returns 0 when the batch is full */
+int fpga_batch_add(FPGA_BATCH *b, int chan, const unsigned char *data, size_t n);
+/* send the queued writes and empty the batch. With fpgalink built with
+ * -DFPGALINK_ASYNC they go out as back-to-back asynchronous writes, with
+ * flcli as the actions of as few runs as FLCLI_CHUNK allows */
+int fpga_batch_flush(FPGA *f, FPGA_BATCH *b);
+/* count reads, at most FPGA_BATCH_MAX, straight into their buffers in one
+ * session. fpgalink with -DFPGALINK_ASYNC submits them all before waiting,
+ * flcli issues them as the actions of a single run */
+int fpga_read_batch(FPGA *f, const FPGA_READ *r, int count);
+
+#endif
@@ -0,0 +1,35 @@
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hexcodec.h"
+
+static const char digits[] = "0123456789abcdef";
+
+size_t hex_encode(const unsigned char *src, size_t n, char *dst)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i gap = _mm_set1_epi8('a' - '0' - 10);
+	for(;i+16<=n;i+=16){
+		__m128i x = _mm_loadu_si128((const __m128i *)(src+i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+		__m128i lo = _mm_and_si128(x, mask);
+		/* high nibble first, then to '0'..'9' or 'a'..'f' */
+		__m128i a = _mm_unpacklo_epi8(hi, lo);
+		__m128i b = _mm_unpackhi_epi8(hi, lo);
+		a = _mm_add_epi8(_mm_add_epi8(a, zero), _mm_and_si128(_mm_cmpgt_epi8(a, nine), gap));
+		b = _mm_add_epi8(_mm_add_epi8(b, zero), _mm_and_si128(_mm_cmpgt_epi8(b, nine), gap));
+		_mm_storeu_si128((__m128i *)(dst+2*i), a);
+		_mm_storeu_si128((__m128i *)(dst+2*i+16), b);
+	}
+#endif
+	for(;i<n;i++){
+		dst[2*i] = digits[src[i] >> 4];
+		dst[2*i+1] = digits[src[i] & 15];
+	}
+	return 2*n;
+}
@@ -0,0 +1,14 @@
+/* Lower-case ASCII hex of byte buffers, for the write commands of flcli.
+ * One pass over the data, 16 bytes at a time with SSE2, into a buffer the
+ * caller preallocates. Reads come back from flcli as raw bytes.
+ */
+
+#ifndef HEXCODEC_H
+#define HEXCODEC_H
+
+#include <stddef.h>
+
+/* writes 2*n characters to dst, no terminating 0, returns 2*n */
+size_t hex_encode(const unsigned char *src, size_t n, char *dst);
+
+#endif
@@ -0,0 +1,135 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "histogram.h"
+
+static int num_threads(void)
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+static int thread_id(void)
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+/* Every thread counts its share of the plane into SUB_HISTS tables of its
+ * own, taking 8 pixels per load and spreading consecutive bytes over the
+ * tables. The tables of all threads are then summed bin by bin, with the
+ * 256 bins divided among the same threads. */
+void histogram_plane(const unsigned char *p, size_t n, unsigned int hist[256])
+{
+	int T = num_threads();
+	unsigned int *sub = (unsigned int *)calloc((size_t)T * SUB_HISTS * 256, sizeof(unsigned int));
+	int b;
+
+	if(sub==NULL){
+		size_t i;
+		memset(hist, 0, 256 * sizeof(unsigned int));
+		for(i=0;i<n;i++) hist[p[i]]++;
+		return;
+	}
+
+	#pragma omp parallel num_threads(T)
+	{
+		int t = thread_id(), nt = T;
+		size_t start, end, i;
+		unsigned int *h0 = sub + (size_t)t * SUB_HISTS * 256;
+		unsigned int *h1 = h0 + 256, *h2 = h0 + 512, *h3 = h0 + 768;
+		uint64_t w;
+
+		#ifdef _OPENMP
+		nt = omp_get_num_threads();	/* may be fewer than asked for */
+		#endif
+		start = n * t / nt;
+		end = n * (t + 1) / nt;
+		for(i=start;i+8<=end;i+=8){
+			memcpy(&w, p + i, 8);
+			h0[w & 0xff]++;
+			h1[(w >> 8) & 0xff]++;
+			h2[(w >> 16) & 0xff]++;
+			h3[(w >> 24) & 0xff]++;
+			h0[(w >> 32) & 0xff]++;
+			h1[(w >> 40) & 0xff]++;
+			h2[(w >> 48) & 0xff]++;
+			h3[(w >> 56) & 0xff]++;
+		}
+		for(;i<end;i++) h0[p[i]]++;
+
+		#pragma omp barrier
+		#pragma omp for
+		for(b=0;b<256;b++){
+			unsigned int s = 0;
+			int k;
+			for(k=0;k<T*SUB_HISTS;k++) s += sub[(size_t)k * 256 + b];
+			hist[b] = s;
+		}
+	}
+	free(sub);
+}
+
+/* classic CDF mapping: the darkest present level goes to 0, the brightest to 255 */
+void equalize_lut(const unsigned int hist[256], size_t n, unsigned char lut[256])
+{
+	size_t cdf = 0, cdf_min = 0;
+	int v;
+
+	for(v=0;v<256;v++)
+		if(hist[v]){
+			cdf_min = hist[v];
+			break;
+		}
+	if(n <= cdf_min){
+		/* flat plane, nothing to stretch */
+		for(v=0;v<256;v++) lut[v] = (unsigned char)v;
+		return;
+	}
+	for(v=0;v<256;v++){
+		cdf += hist[v];
+		if(cdf <= cdf_min)
+			lut[v] = 0;
+		else
+			lut[v] = (unsigned char)(((cdf - cdf_min) * 255 + (n - cdf_min) / 2) / (n - cdf_min));
+	}
+}
+
+void apply_lut(unsigned char *p, size_t n, const unsigned char lut[256])
+{
+	long i, m = (long)(n / 8);
+
+	#pragma omp parallel for
+	for(i=0;i<m;i++){
+		unsigned char *q = p + (size_t)i * 8;
+		q[0] = lut[q[0]]; q[1] = lut[q[1]]; q[2] = lut[q[2]]; q[3] = lut[q[3]];
+		q[4] = lut[q[4]]; q[5] = lut[q[5]]; q[6] = lut[q[6]]; q[7] = lut[q[7]];
+	}
+	for(i=m*8;i<(long)n;i++) p[i] = lut[p[i]];
+}
+
+void equalize_image(IMAGE *img)
+{
+	unsigned int hist[256];
+	unsigned char lut[256];
+	size_t n = (size_t)img->H * img->W;
+	int k;
+
+	for(k=0;k<NUM_PLANES;k++){
+		if(img->plane[k]==NULL)
+			continue;
+		histogram_plane(img->plane[k], n, hist);
+		equalize_lut(hist, n, lut);
+		apply_lut(img->plane[k], n, lut);
+	}
+}
@@ -0,0 +1,22 @@
+/* Histogram and histogram equalization of the 8-bit image planes.
+ * Used by lowpass.c to normalize contrast before the low-pass filter.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include "image.h"
+
+/* independent partial histograms per thread, so that runs of equal pixels
+ * do not stall on the increment of the same counter */
+#define SUB_HISTS 4
+
+void histogram_plane(const unsigned char *p, size_t n, unsigned int hist[256]);
+void equalize_lut(const unsigned int hist[256], size_t n, unsigned char lut[256]);
+void apply_lut(unsigned char *p, size_t n, const unsigned char lut[256]);
+
+/* equalize every plane of img in place, each with its own LUT */
+void equalize_image(IMAGE *img);
+
+#endif
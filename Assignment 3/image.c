@@ -0,0 +1,94 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "image.h"
+
+int image_alloc(IMAGE *img, int H, int W)
+{
+	int k;
+	img->H = H;
+	img->W = W;
+	/* image_free may see any of them */
+	for(k=0;k<NUM_PLANES;k++)
+		img->plane[k] = NULL;
+	for(k=0;k<NUM_PLANES;k++){
+		img->plane[k] = (unsigned char *)calloc((size_t)H * W, 1);
+		if(img->plane[k]==NULL){
+			image_free(img);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void image_free(IMAGE *img)
+{
+	int k;
+	for(k=0;k<NUM_PLANES;k++){
+		free(img->plane[k]);
+		img->plane[k] = NULL;
+	}
+}
+
+void image_copy(IMAGE *dst, const IMAGE *src)
+{
+	int k;
+	for(k=0;k<NUM_PLANES;k++)
+		if(src->plane[k]!=NULL && dst->plane[k]!=NULL)
+			memcpy(dst->plane[k], src->plane[k], (size_t)src->H * src->W);
+}
+
+void image_select(IMAGE *view, const IMAGE *img, int mask)
+{
+	int k;
+	view->H = img->H;
+	view->W = img->W;
+	for(k=0;k<NUM_PLANES;k++)
+		view->plane[k] = mask & (1 << k) ? img->plane[k] : NULL;
+}
+
+int plane_mask(const char *s)
+{
+	int mask = 0;
+	for(;*s;s++){
+		if(*s=='b') mask |= PLANE_B;
+		else if(*s=='g') mask |= PLANE_G;
+		else if(*s=='r') mask |= PLANE_R;
+		else return 0;
+	}
+	return mask;
+}
+
+void image_from_bgr(IMAGE *img, const unsigned char *RGB, int Wp)
+{
+	int i,j,k;
+	#pragma omp parallel for private(j,k)
+	for (i = 0; i < img->H; i++) {
+		const unsigned char *p = RGB + (size_t)i * Wp;
+		for (k = 0; k < NUM_PLANES; k++){
+			unsigned char *q = img->plane[k];
+			if(q==NULL)
+				continue;
+			q += (size_t)i * img->W;
+			for (j = 0; j < img->W; j++)
+				q[j] = p[3*j+k];
+		}
+	}
+}
+
+void image_to_bgr(const IMAGE *img, unsigned char *RGB, int Wp)
+{
+	int i,j,k;
+	#pragma omp parallel for private(j,k)
+	for (i = 0; i < img->H; i++) {
+		unsigned char *p = RGB + (size_t)i * Wp;
+		for (k = 0; k < NUM_PLANES; k++){
+			const unsigned char *q = img->plane[k];
+			if(q==NULL)
+				continue;
+			q += (size_t)i * img->W;
+			for (j = 0; j < img->W; j++)
+				p[3*j+k] = q[j];
+		}
+	}
+}
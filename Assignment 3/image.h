@@ -0,0 +1,64 @@
+/* Planar 8-bit image shared by the CPU filters and the FPGA host code.
+ * plane[0] is blue, plane[1] green and plane[2] red, the same order as the
+ * bytes of a 24-bit BMP pixel. Each plane is H rows of W bytes, no padding.
+ * A NULL plane is skipped by the filters, image_select makes such a view to
+ * work on some colour planes only.
+ */
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+
+#define NUM_PLANES 3
+
+/* plane masks, bit k selects plane[k] */
+#define PLANE_B 1
+#define PLANE_G 2
+#define PLANE_R 4
+#define PLANES_ALL 7
+
+typedef struct BMP{
+
+	unsigned short bType;           /* Magic number for file */
+	unsigned int   bSize;           /* Size of file */
+	unsigned short bReserved1;      /* Reserved */
+	unsigned short bReserved2;      /* ... */
+	unsigned int   bOffBits;        /* Offset to bitmap data */
+
+	unsigned int  bISize;           /* Size of info header */
+	unsigned int  bWidth;          /* Width of image */
+	unsigned int   bHeight;         /* Height of image */
+	unsigned short bPlanes;         /* Number of color planes */
+	unsigned short bBitCount;       /* Number of bits per pixel */
+	unsigned int  bCompression;    /* Type of compression to use */
+	unsigned int  bSizeImage;      /* Size of image data */
+	int           bXPelsPerMeter;  /* X pixels per meter */
+	int      	    bYPelsPerMeter;  /* Y pixels per meter */
+	unsigned int   bClrUsed;        /* Number of colors used */
+	unsigned int   bClrImportant;   /* Number of important colors */
+}BMP;
+
+typedef struct IMAGE{
+	int H;                          /* rows */
+	int W;                          /* columns, also the row stride */
+	unsigned char *plane[NUM_PLANES];
+}IMAGE;
+
+/* row length in bytes of a 24-bit BMP, including the padding to 4 bytes */
+#define BMP_ROW_BYTES(W) (3 * (W) + ((3 * (W)) % 4 ? 4 - (3 * (W)) % 4 : 0))
+
+int image_alloc(IMAGE *img, int H, int W);
+void image_free(IMAGE *img);
+void image_copy(IMAGE *dst, const IMAGE *src);
+/* view shares the planes of img selected by mask, the others are NULL */
+void image_select(IMAGE *view, const IMAGE *img, int mask);
+/* mask of a string of the letters r, g and b, 0 for anything else */
+int plane_mask(const char *s);
+
+/* split interleaved BGR rows (row stride Wp) into planes, and back.
+ * Bytes of NULL planes are not touched */
+void image_from_bgr(IMAGE *img, const unsigned char *RGB, int Wp);
+void image_to_bgr(const IMAGE *img, unsigned char *RGB, int Wp);
+
+#endif
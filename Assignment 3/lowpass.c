@@ -1,38 +1,26 @@
 /* tested on Fedora 24, 64 bit machine using gcc 6.31 */
+/* gcc -O2 -fopenmp lowpass.c image.c histogram.c box_filter.c dirty_tiles.c temporal.c bilateral.c morphology.c result_cache.c -lm -o lowpass */
 
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-#define MAX_HEIGHT 256
-#define MAX_WIDTH 256
+#include "image.h"
+#include "histogram.h"
+#include "box_filter.h"
+#include "dirty_tiles.h"
+#include "temporal.h"
+#include "bilateral.h"
+#include "morphology.h"
+#include "result_cache.h"
 
 int temp;
 
-typedef struct BMP{ 
 
-	unsigned short bType;           /* Magic number for file */
-	unsigned int   bSize;           /* Size of file */
-	unsigned short bReserved1;      /* Reserved */
-	unsigned short bReserved2;      /* ... */
-	unsigned int   bOffBits;        /* Offset to bitmap data */
-
-	unsigned int  bISize;           /* Size of info header */
-	unsigned int  bWidth;          /* Width of image */
-	unsigned int   bHeight;         /* Height of image */
-	unsigned short bPlanes;         /* Number of color planes */
-	unsigned short bBitCount;       /* Number of bits per pixel */
-	unsigned int  bCompression;    /* Type of compression to use */
-	unsigned int  bSizeImage;      /* Size of image data */
-	int           bXPelsPerMeter;  /* X pixels per meter */
-	int      	    bYPelsPerMeter;  /* Y pixels per meter */
-	unsigned int   bClrUsed;        /* Number of colors used */
-	unsigned int   bClrImportant;   /* Number of important colors */
-}BMP;
-
-int R[MAX_HEIGHT][MAX_WIDTH], G[MAX_HEIGHT][MAX_WIDTH], B[MAX_HEIGHT][MAX_WIDTH];
-int R1[MAX_HEIGHT][MAX_WIDTH], G1[MAX_HEIGHT][MAX_WIDTH], B1[MAX_HEIGHT][MAX_WIDTH];
+IMAGE img;	/* input planes */
+IMAGE out;	/* low-pass output planes */
+IMAGE result;	/* planes written to the output file, NULL ones are left black */
 
 
 //void RGB2YUV();
@@ -41,11 +29,16 @@ int Read_BMP_Header(char *filename, int *h, int *w,BMP *bmp)
 
 	FILE *f;
 	int *p;
-	f=fopen("test.bmp","r");
+	f=fopen(filename,"r");
+	if(f==NULL){
+		printf("Cannot open %s\n",filename);
+		return 0;
+	}
 	printf("\nReading BMP Header ");
 	fread(&bmp->bType,sizeof(unsigned short),1,f);
 	p=(int *)bmp;
 	fread(p+1,sizeof(BMP)-4,1,f);
+	fclose(f);
 	if (bmp->bType != 19778) {
 		printf("Error, not a BMP file!\n");
 		return 0;
@@ -59,7 +52,7 @@ int Read_BMP_Header(char *filename, int *h, int *w,BMP *bmp)
 void Read_BMP_Data(char *filename,int *h,int *w,BMP *bmp)
 {
 
-	int i,j,i1,H,W,Wp,PAD;
+	int i,H,W,Wp,PAD;
 	unsigned char *RGB;
 	FILE *f;
 	printf("\nReading BMP Data ");
@@ -76,15 +69,15 @@ void Read_BMP_Data(char *filename,int *h,int *w,BMP *bmp)
 	
 	fread(RGB, sizeof(unsigned char), Wp * H, f);
 
-	i1=0;
-	for (i = 0; i < H; i++) {
-		for (j = 0; j < W; j++){
-			i1=i*(Wp)+j*3;
-			B[i][j]=RGB[i1];
-			G[i][j]=RGB[i1+1];
-			R[i][j]=RGB[i1+2];
-		}
+	if(img.plane[0]!=NULL && (img.H!=H || img.W!=W)){
+		puts("All frames must have the same size");
+		exit(1);
+	}
+	if(img.plane[0]==NULL && (!image_alloc(&img,H,W) || !image_alloc(&out,H,W))){
+		puts("Cannot allocate image planes");
+		exit(1);
 	}
+	image_from_bgr(&img,RGB,Wp);
 	fclose(f);
 	free(RGB);
 }
@@ -101,16 +94,17 @@ int write_BMP_Header(char *filename,int *h,int *w,BMP *bmp)
 	fwrite(&bmp->bType,sizeof(unsigned short),1,f);
 	p=(int *)bmp;
 	fwrite(p+1,sizeof(BMP)-4,1,f);
+	fclose(f);
 	return 1;
 }
 
 void write_BMP_Data(char *filename,int *h,int *w,BMP *bmp){
 
-	int i,j,i1,H,W,Wp,PAD;
+	int H,W,Wp,PAD;
 	unsigned char *RGB;
 	FILE *f;
 	printf("\nWriting BMP Data\n");
-	f=fopen(filename,"w");
+	f=fopen(filename,"r+b");	/* header is already written */
 	fseek(f, 0, SEEK_SET);
 	fseek(f, bmp->bOffBits, SEEK_SET);
 	W = bmp->bWidth;
@@ -118,69 +112,200 @@ void write_BMP_Data(char *filename,int *h,int *w,BMP *bmp){
 	printf("\nheight = %d width= %d ",H,W);
 	PAD = (3 * W) % 4 ? 4 - (3 * W) % 4 : 0;
 	Wp = 3 * W + PAD;
-	RGB = (unsigned char *)malloc(Wp* H * sizeof(unsigned char));
-	fread(RGB, sizeof(unsigned char), Wp * H, f);
+	RGB = (unsigned char *)calloc(Wp* H, sizeof(unsigned char));
 
-	i1=0;
-	for (i = 0; i < H; i++) {
-		for (j = 0; j < W; j++){
-			i1=i*(Wp)+j*3;
-			RGB[i1]=B[i][j];
-			RGB[i1+1]=G[i][j];
-			RGB[i1+2]=R[i][j];
-		}
-	}
-	for (i = 0; i < H; i++) {
-		for (j = 0; j < W; j++){
-			i1=i*(Wp)+j*3;
-			RGB[i1]=0;
-			RGB[i1+1]=0;
-			//RGB[i1+2]=0;
-		}
-	}
+	image_to_bgr(&result,RGB,Wp);
 	fwrite(RGB, sizeof(unsigned char), Wp * H, f);
 	fclose(f);
 	free(RGB);
 }
 
 
-int main(){
+int main(int argc, char **argv){
 
-	int PERFORM;
 	int h,w;
 	BMP b;
-	int i,j;
+	int i;
 	BMP *bmp=&b;
-
-
-	Read_BMP_Header("test.bmp",&h,&w,bmp);
-
-
-
-	Read_BMP_Data("test.bmp",&h,&w,bmp);
-
-	/* Low pass filtering computation
-	 * */
-	for(i=1;i<h-1;i++)        {
-		for(j=1;j<w-1;j++) {
-
-			R1[i][j] = (R[i-1][j-1]+R[i-1][j]+R[i-1][j+1]+
-					R[i][j-1]+R[i][j]+R[i][j+1]+   
-				    R[i+1][j-1]+R[i+1][j]+R[i+1][j+1])/9;
-
-			G1[i][j] = (G[i-1][j-1]+G[i-1][j]+G[i-1][j+1]+
-					G[i][j-1]+G[i][j]+G[i][j+1]+
-					G[i+1][j-1]+G[i+1][j]+G[i+1][j+1])/9;
-
-			B1[i][j] = (B[i-1][j-1]+B[i-1][j]+B[i-1][j+1]+
-					B[i][j-1]+B[i][j]+B[i][j+1]+
-					B[i+1][j-1]+B[i+1][j]+B[i+1][j+1])/9;
+	int equalize=0;
+	ROI roi={0,0,0,0};	/* whole frame */
+	int tiles=0;		/* tile size of the incremental mode, 0 = off */
+	TILE_CACHE cache;
+	int window=0;		/* frames of the temporal mean, 0 = off */
+	int spatial=0;		/* box filter fused into the temporal mean */
+	TEMPORAL tmp;
+	int radius=0;		/* bilateral filter instead of the box filter, 0 = off */
+	BILATERAL bl;
+	int morph=-1;		/* morphology instead of the box filter, -1 = off */
+	int kw=0,kh=0;		/* its structuring rectangle */
+	int planes=PLANES_ALL;	/* colour planes to filter and write */
+	IMAGE src,dst;		/* img and out restricted to those planes */
+	char **frames=(char **)malloc(argc*sizeof(char *));
+	int nframes=0;
+	char outname[64];
+	const char *cache_dir=NULL;	/* results kept across frames and runs, "-" in memory only */
+	RESULT_CACHE rc;
+	RESULT_KEY key;
+	int params[5],cached;
+
+	memset(&cache,0,sizeof(cache));
+	memset(&tmp,0,sizeof(tmp));
+	for(i=1;i<argc;i++){
+		if(strcmp(argv[i],"-e")==0)
+			equalize=1;	/* histogram equalization before filtering */
+		else if(strcmp(argv[i],"-r")==0 && i+4<argc){
+			/* filter only columns x..x+w-1 of rows y..y+h-1 */
+			roi.x=atoi(argv[++i]);
+			roi.y=atoi(argv[++i]);
+			roi.w=atoi(argv[++i]);
+			roi.h=atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i],"-t")==0 && i+1<argc)
+			tiles=atoi(argv[++i]);	/* refilter only tiles changed since the last frame */
+		else if((strcmp(argv[i],"-T")==0 || strcmp(argv[i],"-S")==0) && i+1<argc){
+			/* mean of each pixel over the last n frames, -S also over its 3x3 neighbours */
+			spatial=argv[i][1]=='S';
+			window=atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i],"-b")==0 && i+1<argc)
+			radius=atoi(argv[++i]);	/* edge preserving, window of 2*radius+1 */
+		else if(strcmp(argv[i],"-m")==0 && i+3<argc){
+			/* erode, dilate, open or close with a kw x kh rectangle */
+			morph=morph_op(argv[++i]);
+			kw=atoi(argv[++i]);
+			kh=atoi(argv[++i]);
+			if(morph<0 || kw<1 || kh<1){
+				puts("-m takes erode|dilate|open|close and the rectangle width and height");
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i],"-c")==0 && i+1<argc){
+			/* e.g. -c r filters and writes only the red plane */
+			planes=plane_mask(argv[++i]);
+			if(!planes){
+				puts("-c takes a combination of the letters r, g and b");
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i],"-C")==0 && i+1<argc)
+			cache_dir=argv[++i];	/* frames filtered before are not filtered again */
+		else if(argv[i][0]!='-')
+			frames[nframes++]=argv[i];
+		else{
+			printf("usage: %s [-e] [-c rgb] [-C dir|-] [-r x y w h | -t tile | -T n | -S n | -b radius | -m op kw kh] [frame.bmp ...]\n",argv[0]);
+			return 1;
 		}
 	}
+	if(nframes==0)
+		frames[nframes++]="test.bmp";
+	if((tiles!=0)+(roi.w!=0)+(window!=0)+(radius!=0)+(morph>=0)>1){
+		puts("-r, -t, -T/-S, -b and -m cannot be combined");
+		return 1;
+	}
+	if(radius && !bilateral_init(&bl,radius,radius,BILATERAL_SIGMA_R)){
+		printf("Bilateral radius must be 1 to %d\n",MAX_BILATERAL_RADIUS);
+		return 1;
+	}
+	/* the tile and temporal modes depend on the frames before */
+	if(tiles || window)
+		cache_dir=NULL;
+	if(cache_dir!=NULL)
+		result_cache_init(&rc,RESULT_CACHE_MEM,cache_dir);
+
+	for(i=0;i<nframes;i++){
+		if(!Read_BMP_Header(frames[i],&h,&w,bmp))
+			return 1;
+		Read_BMP_Data(frames[i],&h,&w,bmp);
+
+		image_select(&src,&img,planes);
+		image_select(&dst,&out,planes);
+		image_select(&result,&out,planes);
+		if(equalize)
+			equalize_image(&src);
+
+		/* the key is of the pixels that are filtered and the filter */
+		cached=0;
+		if(cache_dir!=NULL){
+			if(radius){
+				params[0]=radius;
+				params[1]=(int)(BILATERAL_SIGMA_R*1000);
+				result_key_init(&key,RESULT_BILATERAL,params,2);
+			}
+			else if(morph>=0){
+				params[0]=morph;
+				params[1]=kw;
+				params[2]=kh;
+				result_key_init(&key,RESULT_MORPH,params,3);
+			}
+			else{
+				ROI r={0,0,0,0};
+				roi_clip(&roi,h,w,&r);
+				params[0]=r.x;
+				params[1]=r.y;
+				params[2]=r.w;
+				params[3]=r.h;
+				params[4]=result_producer(NULL);
+				result_key_init(&key,RESULT_LOWPASS,params,5);
+			}
+			result_key_image(&key,&src,planes);
+			cached=result_cache_get_image(&rc,&key,&dst,planes);
+		}
 
-
-	write_BMP_Header("alowpass.bmp",&h,&w,bmp);
-	write_BMP_Data("alowpass.bmp",&h,&w,bmp);
+		/* Low pass filtering computation, pixels outside the region
+		 * and on the border of the frame are copied through
+		 * */
+		if(cached)
+			;
+		else if(window){
+			if(tmp.ring==NULL && !temporal_init(&tmp,h,w,window)){
+				printf("Cannot keep %d frames, at most %d\n",window,MAX_TEMPORAL_FRAMES);
+				return 1;
+			}
+			temporal_lowpass(&tmp,&src,&dst,spatial);
+		}
+		else if(radius)
+			bilateral_image(&bl,&src,&dst);
+		else if(morph>=0){
+			if(!morph_image(&src,&dst,morph,kw,kh)){
+				puts("Cannot allocate the morphology buffers");
+				return 1;
+			}
+		}
+		else if(tiles){
+			if(cache.changed==NULL && !tile_cache_init(&cache,h,w,tiles)){
+				puts("Cannot allocate tile cache");
+				return 1;
+			}
+			tile_cache_lowpass(&cache,&src);
+			image_select(&result,&cache.out,planes);
+		}
+		else{
+			image_copy(&dst,&src);
+			lowpass_image(&src,&dst,&roi);
+		}
+		if(cache_dir!=NULL && !cached)
+			result_cache_put_image(&rc,&key,&dst,planes);
+
+		if(nframes==1)
+			strcpy(outname,"alowpass.bmp");
+		else
+			sprintf(outname,"alowpass%03d.bmp",i);
+		write_BMP_Header(outname,&h,&w,bmp);
+		write_BMP_Data(outname,&h,&w,bmp);
+	}
+	if(tiles){
+		tile_cache_stats(&cache,stdout);
+		tile_cache_free(&cache);
+	}
+	if(cache_dir!=NULL){
+		printf("\n");
+		result_cache_stats(&rc,stdout);
+		result_cache_free(&rc);
+	}
+	temporal_free(&tmp);
+	image_free(&img);
+	image_free(&out);
+	free(frames);
 	printf("\n");
 	return 0;
 }
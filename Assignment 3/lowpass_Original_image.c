@@ -1,4 +1,6 @@
 /* tested on Fedora 24, 64 bit machine using gcc 6.31 */
+/* gcc -O2 -mssse3 -fopenmp -DFPGALINK lowpass_Original_image.c image.c box_filter.c polyphase.c verify.c fpga_transport.c fpga_pipeline.c deltarle.c fpga_daemon_client.c fpga_replay.c result_cache.c hexcodec.c -lfpgalink -o lowpass_fpga */
+/* without a board: gcc -O2 -mssse3 -fopenmp -DFPGA_EMULATOR lowpass_Original_image.c image.c box_filter.c polyphase.c verify.c fpga_transport.c fpga_pipeline.c deltarle.c fpga_daemon_client.c fpga_replay.c result_cache.c fpga_emulator.c hexcodec.c -o lowpass_emu */
 
 
 #include <string.h>
@@ -6,43 +8,176 @@
 #include <math.h>
 #include <stdlib.h>
 
-#define MAX_HEIGHT 256
-#define MAX_WIDTH 256
+#include "image.h"
+#include "box_filter.h"
+#include "polyphase.h"
+#include "verify.h"
+#include "fpga_transport.h"
+#include "fpga_pipeline.h"
+#include "deltarle.h"
+#include "fpga_daemon.h"
+#include "result_cache.h"
+
+ROI roi;		/* region to filter, w=0 for the whole frame */
+ROI win;		/* roi plus its one-pixel halo, the window sent to the FPGA */
+IMAGE img;		/* input planes, copied through outside roi */
+int verify;		/* check the readback against the software low-pass */
+int planes=PLANES_ALL;	/* colour planes to upload, filter and read back */
+const char *plane_name[NUM_PLANES]={"blue","green","red"};
+const char *backend;	/* transport backend, NULL for the default */
+FPGA fpga;
+FPGA board[FPGA_BOARDS_MAX];	/* the boards of the pipeline */
+int nboards=1;
+const char *link_model;	/* "MBps:latency_us" of the emulated USB link */
+const char *stats_file;	/* transfer statistics go there as JSON */
+int coded;		/* upload the phases delta/run-length coded */
+PIPE_CODING coding;	/* bytes of the phases before and after coding */
+const char *daemon_path;	/* socket of fpga_daemon, NULL to open the board here */
+const char *trace_file;	/* the transfers are recorded there */
+const char *replay;	/* "trace[@speed]" played back instead of a board */
+const char *cache_dir;	/* results of frames seen before, "-" in memory only */
+const char *tune_file;	/* the fastest transfer shape is saved there */
+const char *shape_file;	/* transfer shape of an earlier -A */
+RESULT_CACHE cache;
+
+#define PHASES 3	/* the fabric holds a plane as 3 x 3 phases */
+#define DESIGN_ID "LP27"	/* identity of top_level_27 on FPGA_ID_CHAN */
 
-;
+//void RGB2YUV();
+void print_coding(void)
+{
+	if(coded && coding.sent>0)
+		printf("coded uploads: %lu of %lu bytes, ratio %.2f\n",(unsigned long)coding.sent,
+			(unsigned long)coding.raw,(double)coding.raw/coding.sent);
+}
 
-typedef struct BMP{
+/* time the transfer shapes on the frames and save the fastest one, which
+ * the frames then go with. With -z the shapes are timed with coded
+ * uploads too, those bytes are not part of the ratio printed */
+void autotune(FPGA *boards,int nb,const IMAGE *in,IMAGE *out,int n)
+{
+	PIPE_TUNE tune[PIPE_TUNE_MAX];
+	PIPE_SHAPE best;
+	PIPE_CODING scratch={0,0};
+	int i,count;
+
+	count=pipeline_autotune(boards,nb,in,out,n,&roi,planes,coded ? &scratch : NULL,tune);
+	if(count==0){
+		printf("Cannot tune the transfers: %s\n",boards[0].error);
+		exit(1);
+	}
+	pipeline_get_shape(&best);
+	printf("chunk  order       ms/run    MB/s\n");
+	for(i=0;i<count;i++)
+		printf("%5lu  %-10s %7.3f %7.2f%s\n",(unsigned long)tune[i].shape.chunk,
+			pipeline_order_name(tune[i].shape.order),tune[i].seconds*1e3,tune[i].rate/1e6,
+			memcmp(&tune[i].shape,&best,sizeof(best))==0 ? "  <- best" : "");
+	if(!pipeline_shape_save(tune_file,&best))
+		printf("Cannot write %s\n",tune_file);
+}
 
-	unsigned short bType;           /* Magic number for file */
-	unsigned int   bSize;           /* Size of file */
-	unsigned short bReserved1;      /* Reserved */
-	unsigned short bReserved2;      /* ... */
-	unsigned int   bOffBits;        /* Offset to bitmap data */
+/* compare the readback with the software model of the fabric, the
+ * differences are written to lowpass_diff.bmp */
+void verify_output(const IMAGE *input,unsigned char *RGB,int Wp,BMP *bmp)
+{
+	IMAGE in,fpga;
+	VERIFY_REPORT rep;
+
+	if(!image_alloc(&fpga,input->H,input->W)){
+		puts("Cannot allocate verification planes");
+		return;
+	}
+	image_from_bgr(&fpga,RGB,Wp);
+	image_select(&in,input,planes);
+	if(verify_lowpass(&in,&fpga,&roi,&rep)<0)
+		puts("Cannot allocate verification planes");
+	else{
+		verify_print(&rep,stdout);
+		if(!verify_write_heatmap(&rep,bmp,"lowpass_diff.bmp"))
+			puts("Cannot write lowpass_diff.bmp");
+		verify_free(&rep);
+	}
+	image_free(&fpga);
+}
+
+/* channel of phase (pi,pj) of plane k */
+int phase_channel(int k,int pi,int pj)
+{
+	return 16*k+1+pi+PHASES*pj;
+}
 
-	unsigned int  bISize;           /* Size of info header */
-	unsigned int  bWidth;          /* Width of image */
-	unsigned int   bHeight;         /* Height of image */
-	unsigned short bPlanes;         /* Number of color planes */
-	unsigned short bBitCount;       /* Number of bits per pixel */
-	unsigned int  bCompression;    /* Type of compression to use */
-	unsigned int  bSizeImage;      /* Size of image data */
-	int           bXPelsPerMeter;  /* X pixels per meter */
-	int      	    bYPelsPerMeter;  /* Y pixels per meter */
-	unsigned int   bClrUsed;        /* Number of colors used */
-	unsigned int   bClrImportant;   /* Number of important colors */
-}BMP;
+/* the backend the frames go through */
+const char *backend_name(void)
+{
+	if(replay!=NULL)
+		return "replay";
+	return backend!=NULL ? backend : fpga_default_backend();
+}
+
+/* start the connection with up to n boards, returns how many were
+ * found. flcli loads the design into a board only when it does not have
+ * it yet */
+int open_fpga(FPGA *f,int n)
+{
+	char device[64],names[FPGA_BOARDS_MAX][FPGA_NAME_LEN],cmd[FPGA_NAME_LEN+32],file[FPGA_NAME_LEN+16];
+	const char *dev;
+	int i,soft,r;
+
+	backend=backend_name();
+	soft=strcmp(backend,"loopback")==0 || strcmp(backend,"emulator")==0 || replay!=NULL;
+	sprintf(device,"%.32s",link_model ? link_model : "0:0");
+	dev=replay!=NULL ? replay : strcmp(backend,"emulator")==0 ? device : NULL;
+	n=fpga_enumerate(backend,dev,names,n);
+	if(n<0)
+	{
+		printf("Device name too long: %s\n",dev);
+		exit(1);
+	}
+	if(n==0)
+	{
+		printf("No board found with the %s backend\n",backend);
+		exit(1);
+	}
+	for(i=0;i<n;i++)
+	{
+		sprintf(cmd,"sh fpga-link_init.sh %.*s",FPGA_NAME_LEN,names[i]);
+		r=fpga_open_design(&f[i],backend,names[i],DESIGN_ID,soft ? NULL : cmd);
+		if(!r)
+		{
+			printf("Cannot open the FPGA %s: %s\n",names[i],f[i].error);
+			exit(1);
+		}
+		if(r==2)
+			printf("loaded the design into %s\n",names[i]);
+		/* board i>0 records to trace.i */
+		if(trace_file!=NULL){
+			if(i==0)
+				snprintf(file,sizeof(file),"%s",trace_file);
+			else
+				snprintf(file,sizeof(file),"%.*s.%d",FPGA_NAME_LEN,trace_file,i);
+			if(!fpga_record(&f[i],file))
+				printf("Cannot record to %s\n",file);
+		}
+	}
+	printf("transport: %s, %d board%s\n",f[0].ops->name,n,n>1 ? "s" : "");
+	return n;
+}
 
-//void RGB2YUV();
 int Read_BMP_Header(char *filename, int *h, int *w,BMP *bmp)
 {
 
 	FILE *f;
 	int *p;
-	f=fopen("test.bmp","r");
+	f=fopen(filename,"r");
+	if(f==NULL){
+		printf("Cannot open %s\n",filename);
+		return 0;
+	}
 	printf("\nReading BMP Header ");
 	fread(&bmp->bType,sizeof(unsigned short),1,f);
 	p=(int *)bmp;
 	fread(p+1,sizeof(BMP)-4,1,f);
+	fclose(f);
 	if (bmp->bType != 19778) {
 		printf("Error, not a BMP file!\n");
 		return 0;
@@ -56,8 +191,13 @@ int Read_BMP_Header(char *filename, int *h, int *w,BMP *bmp)
 void Read_BMP_Data(char *filename,int *h,int *w,BMP *bmp)
 {
 
-	int i,j,i1,H,W,Wp,PAD;
-	unsigned char *RGB;
+	int i,k,p,H,W,Wp,PAD;
+	size_t o;
+	unsigned char *RGB,*phase,*code=NULL;
+	static const unsigned char strobe=0;
+	static const unsigned char unbanked=PIPE_UNBANKED;
+	static unsigned char mode,last[2];
+	FPGA_BATCH batch;
 	FILE *f;
 	printf("\nReading BMP Data ");
 	f=fopen(filename,"r");
@@ -72,208 +212,85 @@ void Read_BMP_Data(char *filename,int *h,int *w,BMP *bmp)
 	for(i=0;i<Wp*H;i++) RGB[i]=0;
 	fread(RGB, sizeof(unsigned char), Wp * H, f);
 
-//	for(i=0;i<256;i++)
-//	printf("%d ",RGB[i]);
-
-	FILE **output=(FILE**)malloc(sizeof(FILE*));
-	char hex[3][3]; //hex[0] means B hex[1] means G hex[2] means R
-	output[0]=fopen("string0.sh","w");
-	output[1]=fopen("string1.sh","w");
-	output[2]=fopen("string2.sh","w");
-	if(output[0]==NULL || output[1]==NULL || output[2]==NULL)
+	if(!image_alloc(&img,H,W))
 	{
-		puts("Cannot open output file");
+		puts("Cannot allocate image planes");
 		exit(1);
 	}
-	
-	fprintf(output[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(output[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(output[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	//traversing row wise starting from (1,1) to (256,256)
-	//string0 blue
-	//string1 green
-	//string2 red
-	
-	i1=0;
-	fprintf(output[0],"./win32/rel/flcli -v 1443:0007 -a \"w1 ");
-	fprintf(output[1],"./win32/rel/flcli -v 1443:0007 -a \"w11 ");
-	fprintf(output[2],"./win32/rel/flcli -v 1443:0007 -a \"w21 ");
-	for (i = 0; i < H; i+=3){
-		for (j = 0; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			sprintf(hex[0],"%02x",RGB[i1]);
-			fprintf(output[0],hex[0]);
-
-			sprintf(hex[1],"%02x",RGB[i1+1]);
-			fprintf(output[1],hex[1]);
-
-			sprintf(hex[2],"%02x",RGB[i1+2]);
-			fprintf(output[2],hex[2]);
-		}
-	}
+	image_from_bgr(&img,RGB,Wp);
 
-	i1=0;
-	fprintf(output[0],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w2 ");
-	fprintf(output[1],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w12 ");
-	fprintf(output[2],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w22 ");
-	for (i = 1; i < H; i+=3){
-		for (j = 0; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			sprintf(hex[0],"%02x",RGB[i1]);
-			fprintf(output[0],hex[0]);
-
-			sprintf(hex[1],"%02x",RGB[i1+1]);
-			fprintf(output[1],hex[1]);
-
-			sprintf(hex[2],"%02x",RGB[i1+2]);
-			fprintf(output[2],hex[2]);
-		}
-	}
-
-	i1=0;
-	fprintf(output[0],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w3 ");
-	fprintf(output[1],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w13 ");
-	fprintf(output[2],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w23 ");
-	for (i = 2; i < H; i+=3){
-		for (j = 0; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			sprintf(hex[0],"%02x",RGB[i1]);
-			fprintf(output[0],hex[0]);
-
-			sprintf(hex[1],"%02x",RGB[i1+1]);
-			fprintf(output[1],hex[1]);
-
-			sprintf(hex[2],"%02x",RGB[i1+2]);
-			fprintf(output[2],hex[2]);
-		}
-	}
-
-	i1=0;
-	fprintf(output[0],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w4 ");
-	fprintf(output[1],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w14 ");
-	fprintf(output[2],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w24 ");
-	for (i = 0; i < H; i+=3){
-		for (j = 1; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			sprintf(hex[0],"%02x",RGB[i1]);
-			fprintf(output[0],hex[0]);
-
-			sprintf(hex[1],"%02x",RGB[i1+1]);
-			fprintf(output[1],hex[1]);
-
-			sprintf(hex[2],"%02x",RGB[i1+2]);
-			fprintf(output[2],hex[2]);
-		}
-	}
+	/* only roi and its halo are uploaded */
+	roi_clip(&roi,H,W,&roi);
+	roi_halo(&roi,H,W,&win);
 
-	i1=0;
-	fprintf(output[0],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w5 ");
-	fprintf(output[1],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w15 ");
-	fprintf(output[2],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w25 ");
-	for (i = 1; i < H; i+=3){
-		for (j = 1; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			sprintf(hex[0],"%02x",RGB[i1]);
-			fprintf(output[0],hex[0]);
-
-			sprintf(hex[1],"%02x",RGB[i1+1]);
-			fprintf(output[1],hex[1]);
-
-			sprintf(hex[2],"%02x",RGB[i1+2]);
-			fprintf(output[2],hex[2]);
-		}
-	}
+//	for(i=0;i<256;i++)
+//	printf("%d ",RGB[i]);
 
-	i1=0;
-	fprintf(output[0],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w6 ");
-	fprintf(output[1],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w16 ");
-	fprintf(output[2],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w26 ");
-	for (i = 2; i < H; i+=3){
-		for (j = 1; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			sprintf(hex[0],"%02x",RGB[i1]);
-			fprintf(output[0],hex[0]);
-
-			sprintf(hex[1],"%02x",RGB[i1+1]);
-			fprintf(output[1],hex[1]);
-
-			sprintf(hex[2],"%02x",RGB[i1+2]);
-			fprintf(output[2],hex[2]);
-		}
+	open_fpga(&fpga,1);
+
+	/* Send data to FPGA, phase (pi,pj) of plane k goes to channel
+	 * 16*k + 1 + pi + 3*pj. The phases of all requested planes are
+	 * packed into one buffer and go out as a single batch, planes that
+	 * were not requested are not sent. A pipeline run before may have
+	 * left the board banked, so the batch unbanks it first and sets the
+	 * last column and row of the window, which main keeps to
+	 * PIPE_WINDOW_MAX a side. With -z every phase is coded on its own
+	 * and channel 0x0d has the fabric decode them. The strobes follow as
+	 * a batch of their own, so the statistics count them as compute:
+	 * channel 0 rewinds the read and output addresses, selecting channel
+	 * 0x10 runs the filter into the output BRAMs and channel 0 rewinds
+	 * them again. */
+	phase=(unsigned char *)malloc((size_t)NUM_PLANES*win.w*win.h);
+	if(coded)
+		code=(unsigned char *)malloc(DRLE_BOUND((size_t)NUM_PLANES*win.w*win.h)+NUM_PLANES*PHASES*PHASES);
+	if(phase==NULL || (coded && code==NULL))
+	{
+		puts("Cannot allocate phase buffer");
+		exit(1);
 	}
-
-	i1=0;
-	fprintf(output[0],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w7 ");
-	fprintf(output[1],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w17 ");
-	fprintf(output[2],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w27 ");
-	for (i = 0; i < H; i+=3){
-		for (j = 2; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			sprintf(hex[0],"%02x",RGB[i1]);
-			fprintf(output[0],hex[0]);
-
-			sprintf(hex[1],"%02x",RGB[i1+1]);
-			fprintf(output[1],hex[1]);
-
-			sprintf(hex[2],"%02x",RGB[i1+2]);
-			fprintf(output[2],hex[2]);
+	fpga_batch_init(&batch);
+	mode=(unsigned char)coded;
+	last[0]=(unsigned char)(win.w-1);
+	last[1]=(unsigned char)(win.h-1);
+	fpga_batch_add(&batch,PIPE_BANK_CHAN,&unbanked,1);
+	fpga_batch_add(&batch,PIPE_WIDTH_CHAN,&last[0],1);
+	fpga_batch_add(&batch,PIPE_HEIGHT_CHAN,&last[1],1);
+	fpga_batch_add(&batch,PIPE_CODING_CHAN,&mode,1);
+	for(k=0,o=0;k<NUM_PLANES;k++){
+		if(!(planes & (1<<k)))
+			continue;
+		for(p=0;p<PHASES*PHASES;p++){
+			size_t n=polyphase_len(&win,PHASES,p%PHASES,p/PHASES);
+			polyphase_scatter(img.plane[k],W,&win,PHASES,p%PHASES,p/PHASES,phase+o);
+			if(coded){
+				size_t z=drle_encode(phase+o,n,code+coding.sent);
+				fpga_batch_add(&batch,phase_channel(k,p%PHASES,p/PHASES),code+coding.sent,z);
+				coding.raw+=n;
+				coding.sent+=z;
+			}
+			else
+				fpga_batch_add(&batch,phase_channel(k,p%PHASES,p/PHASES),phase+o,n);
+			o+=n;
 		}
 	}
-
-	i1=0;
-	fprintf(output[0],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w8 ");
-	fprintf(output[1],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w18 ");
-	fprintf(output[2],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w28 ");
-	for (i = 1; i < H; i+=3){
-		for (j = 2; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			sprintf(hex[0],"%02x",RGB[i1]);
-			fprintf(output[0],hex[0]);
-
-			sprintf(hex[1],"%02x",RGB[i1+1]);
-			fprintf(output[1],hex[1]);
-
-			sprintf(hex[2],"%02x",RGB[i1+2]);
-			fprintf(output[2],hex[2]);
-		}
+	fpga_phase(&fpga,FPGA_PHASE_UPLOAD);
+	if(!fpga_batch_flush(&fpga,&batch))
+	{
+		printf("Cannot send the image: %s\n",fpga.error);
+		exit(1);
 	}
-
-	i1=0;
-	fprintf(output[0],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w9 ");
-	fprintf(output[1],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w19 ");
-	fprintf(output[2],"\"\n./win32/rel/flcli -v 1443:0007 -a \"w29 ");
-	for (i = 2; i < H; i+=3){
-		for (j = 2; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			sprintf(hex[0],"%02x",RGB[i1]);
-			fprintf(output[0],hex[0]);
-
-			sprintf(hex[1],"%02x",RGB[i1+1]);
-			fprintf(output[1],hex[1]);
-
-			sprintf(hex[2],"%02x",RGB[i1+2]);
-			fprintf(output[2],hex[2]);
-		}
+	fpga_batch_add(&batch,0,&strobe,1);
+	fpga_batch_add(&batch,0x10,&strobe,1);
+	fpga_batch_add(&batch,0,&strobe,1);
+	fpga_phase(&fpga,FPGA_PHASE_COMPUTE);
+	if(!fpga_batch_flush(&fpga,&batch))
+	{
+		printf("Cannot run the filter: %s\n",fpga.error);
+		exit(1);
 	}
-	fprintf(output[0],"\"");
-	fprintf(output[1],"\"");
-	fprintf(output[2],"\"");
-
-	
-	fclose(output[0]);
-	fclose(output[1]);
-	fclose(output[2]);
-
-	//Start connection with FPGA
-	char cmd[]="sh fpga-link_init.sh";
-	system(cmd);
-	//Send data to FPGA
-	char cmd0[]="sh string0.sh";
-	system(cmd0);
-	char cmd1[]="sh string1.sh";
-	system(cmd1);
-	char cmd2[]="sh string2.sh";
-	system(cmd2);
+	free(phase);
+	free(code);
+	print_coding();
 
 	fclose(f);
 	free(RGB);
@@ -297,8 +314,11 @@ int write_BMP_Header(char *filename,int *h,int *w,BMP *bmp)
 
 void write_BMP_Data(char *filename,int *h,int *w,BMP *bmp){
 
-	int i,j,i1,H,W,Wp,PAD;
-	unsigned char *RGB;
+	int i,j,k,H,W,Wp,PAD,n=0;
+	size_t o=0,len=(size_t)win.w*win.h+1;
+	unsigned char *RGB,*buf,*out[NUM_PLANES];
+	FPGA_READ rd[NUM_PLANES];
+	IMAGE view;
 	FILE *f;
 	printf("\nWriting BMP Data\n");
 	f=fopen(filename,"w");
@@ -309,648 +329,291 @@ void write_BMP_Data(char *filename,int *h,int *w,BMP *bmp){
 	printf("\nheight = %d width= %d ",H,W);
 	PAD = (3 * W) % 4 ? 4 - (3 * W) % 4 : 0;
 	Wp = 3 * W + PAD;
-	RGB = (unsigned char *)malloc(Wp* H * sizeof(unsigned char));
-	fread(RGB, sizeof(unsigned char), Wp * H, f);
-
-
-	///////////////////////////// 	COMMANDS FOR READING DATA FROM FPGA /////////////////////
-	FILE **read=(FILE**)malloc(sizeof(FILE*));
-	FILE **outputfinal=(FILE**)malloc(sizeof(FILE*));
-	int temp;
-	char cmd0[]="sh blue_read.sh";
-	char cmd1[]="sh green_read.sh";
-	char cmd2[]="sh red_read.sh";
-
-		//		File i correspond to RAM i of that color  //
-////////////	File 1 	//////////
-
-	read[0]=fopen("blue_read.sh","w");
-	read[1]=fopen("green_read.sh","w");
-	read[2]=fopen("red_read.sh","w");
-	if(read[0]==NULL || read[1]==NULL || read[2]==NULL)
+	RGB = (unsigned char *)calloc(Wp* H, sizeof(unsigned char));
+	/* every output BRAM is read with its stale first byte */
+	buf = (unsigned char *)malloc(NUM_PLANES*len);
+	if(RGB==NULL || buf==NULL)
 	{
-		puts("Cannot open read file");
-		exit(1);
-	}
-	fprintf(read[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-
-
-	fprintf(read[0],"./win32/rel/flcli -v 1443:0007 -a \"r1 1ce5 \\\"blue_write.txt\\\"\"");
-	fprintf(read[1],"./win32/rel/flcli -v 1443:0007 -a \"r11 1ce5 \\\"green_write.txt\\\"\"");
-	fprintf(read[2],"./win32/rel/flcli -v 1443:0007 -a \"r21 1ce5 \\\"red_write.txt\\\"\"");
-
-	fclose(read[0]);
-	fclose(read[1]);
-	fclose(read[2]);
-
-	//Read data from FPGA
-	
-	system(cmd0);
-	system(cmd1);
-	system(cmd2);
-
-	//Read from text file and write to image
-	outputfinal[0]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\blue_write.txt","rb");
-	outputfinal[1]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\green_write.txt","rb");
-	outputfinal[2]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\red_write.txt","rb");
-	if(outputfinal[0]==NULL || outputfinal[1]==NULL || outputfinal[1]==NULL)
-	{
-		puts("Cannot open output file");
-		exit(1);
-	}
-
-	unsigned char hexb[8000] = "";
-    size_t bytesb = 0;
-    bytesb = fread ( &hexb, 1, 8000, outputfinal[0]);
-	unsigned char hexg[8000] = "";
-    size_t bytesg = 0;
-    bytesg = fread ( &hexg, 1, 8000, outputfinal[1]);
-	unsigned char hexr[8000] = "";
-    size_t bytesr = 0;
-    bytesr = fread ( &hexr, 1, 8000, outputfinal[2]);
-
-    int b=1,g=1,r=1;
-	for (i = 0; i < H; i+=3){
-		for (j = 0; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			RGB[i1] = (int)(hexb[b++]);
-			RGB[i1+1] = (int)hexg[g++];
-			RGB[i1+2] = (int)(hexr[r++]);
-		}
-	}
-
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
-
-////////////	File 2 	//////////
-
-	read[0]=fopen("blue_read.sh","w");
-	read[1]=fopen("green_read.sh","w");
-	read[2]=fopen("red_read.sh","w");
-	if(read[0]==NULL || read[1]==NULL || read[2]==NULL)
-	{
-		puts("Cannot open read file");
-		exit(1);
-	}
-	fprintf(read[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-
-
-	fprintf(read[0],"./win32/rel/flcli -v 1443:0007 -a \"r2 1c8f \\\"blue_write.txt\\\"\"");
-	fprintf(read[1],"./win32/rel/flcli -v 1443:0007 -a \"r12 1c8f \\\"green_write.txt\\\"\"");
-	fprintf(read[2],"./win32/rel/flcli -v 1443:0007 -a \"r22 1c8f \\\"red_write.txt\\\"\"");
-
-	fclose(read[0]);
-	fclose(read[1]);
-	fclose(read[2]);
-
-	//Read data from FPGA
-	
-	system(cmd0);
-	system(cmd1);
-	system(cmd2);
-
-	//Read from text file and write to image
-	outputfinal[0]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\blue_write.txt","rb");
-	outputfinal[1]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\green_write.txt","rb");
-	outputfinal[2]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\red_write.txt","rb");
-	if(outputfinal[0]==NULL || outputfinal[1]==NULL || outputfinal[1]==NULL)
-	{
-		puts("Cannot open output file");
+		puts("Cannot allocate output buffers");
 		exit(1);
 	}
 
-	unsigned char hexb1[8000] ="";
-	unsigned char hexg1[8000] ="";
-	unsigned char hexr1[8000] ="";	
-    bytesb = 0;
-    bytesb = fread ( &hexb1, 1, 8000, outputfinal[0]);
-	
-    bytesg = 0;
-    bytesg = fread ( &hexg1, 1, 8000, outputfinal[1]);
-	
-    bytesr = 0;
-    bytesr = fread ( &hexr1, 1, 8000, outputfinal[2]);
-
-    b=g=r=1;
-	for (i = 1; i < H; i+=3){
-		for (j = 0; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			RGB[i1] = (int)(hexb1[b++]); 
-			RGB[i1+1] = (int)(hexg1[g++]);
-			RGB[i1+2] = (int)(hexr1[r++]);
-		}
-	}
-
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
-
-////////////	File 3 	//////////
-
-	read[0]=fopen("blue_read.sh","w");
-	read[1]=fopen("green_read.sh","w");
-	read[2]=fopen("red_read.sh","w");
-	if(read[0]==NULL || read[1]==NULL || read[2]==NULL)
-	{
-		puts("Cannot open read file");
-		exit(1);
+	/* the output BRAM of each requested colour holds the window row by
+	 * row, all are read into buf in one session */
+	for(k=0;k<NUM_PLANES;k++){
+		if(!(planes & (1<<k)))
+			continue;
+		rd[n].chan=PIPE_OUT_CHAN+k;
+		rd[n].data=buf+o;
+		rd[n++].n=len;
+		out[k]=buf+o+1;
+		o+=len;
 	}
-	fprintf(read[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-
-
-	fprintf(read[0],"./win32/rel/flcli -v 1443:0007 -a \"r3 1c8f \\\"blue_write.txt\\\"\"");
-	fprintf(read[1],"./win32/rel/flcli -v 1443:0007 -a \"r13 1c8f \\\"green_write.txt\\\"\"");
-	fprintf(read[2],"./win32/rel/flcli -v 1443:0007 -a \"r23 1c8f \\\"red_write.txt\\\"\"");
-
-	fclose(read[0]);
-	fclose(read[1]);
-	fclose(read[2]);
-
-	//Read data from FPGA
-	
-	system(cmd0);
-	system(cmd1);
-	system(cmd2);
-
-	//Read from text file and write to image
-	outputfinal[0]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\blue_write.txt","rb");
-	outputfinal[1]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\green_write.txt","rb");
-	outputfinal[2]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\red_write.txt","rb");
-	if(outputfinal[0]==NULL || outputfinal[1]==NULL || outputfinal[1]==NULL)
+	fpga_phase(&fpga,FPGA_PHASE_READBACK);
+	if(!fpga_read_batch(&fpga,rd,n))
 	{
-		puts("Cannot open output file");
+		printf("Cannot read the result: %s\n",fpga.error);
 		exit(1);
 	}
 
+	/* input outside roi, planes that were not requested are left black,
+	 * then the roi pixels of the window */
+	image_select(&view,&img,planes);
+	image_to_bgr(&view,RGB,Wp);
+	for(k=0;k<NUM_PLANES;k++)
+		if(planes & (1<<k))
+			for(i=roi.y;i<roi.y+roi.h;i++)
+				for(j=roi.x;j<roi.x+roi.w;j++)
+					RGB[(size_t)i*Wp+3*j+k]=out[k][(size_t)(i-win.y)*win.w+j-win.x];
+	free(buf);
 
-	unsigned char hexb2[8000] ="";
-	unsigned char hexg2[8000] ="";
-	unsigned char hexr2[8000] ="";
-	
-    bytesb = 0;
-    bytesb = fread ( &hexb2, 1, 8000, outputfinal[0]);
-	
-    bytesg = 0;
-    bytesg = fread ( &hexg2, 1, 8000, outputfinal[1]);
-	
-    bytesr = 0;
-    bytesr = fread ( &hexr2, 1, 8000, outputfinal[2]);
-
-    b=g=r=1;
-	for (i = 2; i < H; i+=3){
-		for (j = 0; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			RGB[i1] = (int)(hexb2[b++]); 
-			RGB[i1+1] = (int)(hexg2[g++]);
-			RGB[i1+2] = (int)(hexr2[r++]);
-		}
-	}
-	
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
-
-////////////	File 4 	//////////
+	if(verify)
+		verify_output(&img,RGB,Wp,bmp);
+	fwrite(RGB, sizeof(unsigned char), Wp * H, f);
+	fclose(f);
+	free(RGB);
+}
 
-	read[0]=fopen("blue_read.sh","w");
-	read[1]=fopen("green_read.sh","w");
-	read[2]=fopen("red_read.sh","w");
-	if(read[0]==NULL || read[1]==NULL || read[2]==NULL)
-	{
-		puts("Cannot open read file");
-		exit(1);
-	}
-	fprintf(read[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-
-
-	fprintf(read[0],"./win32/rel/flcli -v 1443:0007 -a \"r4 1c8f \\\"blue_write.txt\\\"\"");
-	fprintf(read[1],"./win32/rel/flcli -v 1443:0007 -a \"r14 1c8f \\\"green_write.txt\\\"\"");
-	fprintf(read[2],"./win32/rel/flcli -v 1443:0007 -a \"r24 1c8f \\\"red_write.txt\\\"\"");
-
-	fclose(read[0]);
-	fclose(read[1]);
-	fclose(read[2]);
-
-	//Read data from FPGA
-	
-	system(cmd0);
-	system(cmd1);
-	system(cmd2);
-
-	//Read from text file and write to image
-	outputfinal[0]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\blue_write.txt","rb");
-	outputfinal[1]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\green_write.txt","rb");
-	outputfinal[2]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\red_write.txt","rb");
-	if(outputfinal[0]==NULL || outputfinal[1]==NULL || outputfinal[1]==NULL)
-	{
-		puts("Cannot open output file");
-		exit(1);
-	}
+/* several frames of one size, or one too large for the BRAMs, go through
+ * the two BRAM banks of the fabric as a pipeline of tiles, or to the
+ * daemon with -D. Frames in the cache are not sent at all. Frame i is
+ * written to lowpass%03d.bmp, a single frame to lowpass.bmp */
+void lowpass_frames(char **frames,int n)
+{
+	int i,m,h=0,w=0,Wp=0,PAD,tw,th;
+	long done[FPGA_BOARDS_MAX];
+	BMP bmp,first;
+	IMAGE *in,*out,*fin,*fout,view;
+	RESULT_KEY *key;
+	unsigned char *RGB=NULL;
+	char outname[32],error[DAEMON_ERROR_LEN];
+	FILE *f;
 
-	;
-
-	unsigned char hexb3[8000] ="";
-	unsigned char hexg3[8000] ="";
-	unsigned char hexr3[8000] ="";
-	
-    bytesb = 0;
-    bytesb = fread ( &hexb3, 1, 8000, outputfinal[0]);
-	
-    bytesg = 0;
-    bytesg = fread ( &hexg3, 1, 8000, outputfinal[1]);
-	
-    bytesr = 0;
-    bytesr = fread ( &hexr3, 1, 8000, outputfinal[2]);
-
-    b=g=r=1;
-	for (i = 0; i < H; i+=3){
-		for (j = 1; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			RGB[i1] = (int)(hexb3[b++]); 
-			RGB[i1+1] = (int)(hexg3[g++]);
-			RGB[i1+2] = (int)(hexr3[r++]);
+	in=(IMAGE *)calloc(n,sizeof(IMAGE));
+	out=(IMAGE *)calloc(n,sizeof(IMAGE));
+	fin=(IMAGE *)calloc(n,sizeof(IMAGE));
+	fout=(IMAGE *)calloc(n,sizeof(IMAGE));
+	key=(RESULT_KEY *)calloc(n,sizeof(RESULT_KEY));
+	for(i=0;i<n;i++){
+		if(!Read_BMP_Header(frames[i],&h,&w,&bmp))
+			exit(1);
+		if(i==0)
+			first=bmp;
+		else if(bmp.bWidth!=first.bWidth || bmp.bHeight!=first.bHeight){
+			puts("All frames must have the same size");
+			exit(1);
 		}
-	}
-	
-
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
-
-////////////	File 5 	//////////
-
-	read[0]=fopen("blue_read.sh","w");
-	read[1]=fopen("green_read.sh","w");
-	read[2]=fopen("red_read.sh","w");
-	if(read[0]==NULL || read[1]==NULL || read[2]==NULL)
-	{
-		puts("Cannot open read file");
-		exit(1);
-	}
-	fprintf(read[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-
-
-	fprintf(read[0],"./win32/rel/flcli -v 1443:0007 -a \"r5 1c3a \\\"blue_write.txt\\\"\"");
-	fprintf(read[1],"./win32/rel/flcli -v 1443:0007 -a \"r15 1c3a \\\"green_write.txt\\\"\"");
-	fprintf(read[2],"./win32/rel/flcli -v 1443:0007 -a \"r25 1c3a \\\"red_write.txt\\\"\"");
-
-	fclose(read[0]);
-	fclose(read[1]);
-	fclose(read[2]);
-
-	//Read data from FPGA
-	
-	system(cmd0);
-	system(cmd1);
-	system(cmd2);
-
-	//Read from text file and write to image
-	outputfinal[0]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\blue_write.txt","rb");
-	outputfinal[1]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\green_write.txt","rb");
-	outputfinal[2]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\red_write.txt","rb");
-	if(outputfinal[0]==NULL || outputfinal[1]==NULL || outputfinal[1]==NULL)
-	{
-		puts("Cannot open output file");
-		exit(1);
-	}
-
-	;
-	
-	unsigned char hexb4[8000] ="";
-	unsigned char hexg4[8000] ="";
-	unsigned char hexr4[8000] ="";
-
-	
-    bytesb = 0;
-    bytesb = fread ( &hexb4, 1, 8000, outputfinal[0]);
-	
-    bytesg = 0;
-    bytesg = fread ( &hexg4, 1, 8000, outputfinal[1]);
-	
-    bytesr = 0;
-    bytesr = fread ( &hexr4, 1, 8000, outputfinal[2]);
-
-    b=g=r=1;
-	for (i = 1; i < H; i+=3){
-		for (j = 1; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			RGB[i1] = (int)(hexb4[b++]); 
-			RGB[i1+1] = (int)(hexg4[g++]);
-			RGB[i1+2] = (int)(hexr4[r++]);
+		PAD = (3 * w) % 4 ? 4 - (3 * w) % 4 : 0;
+		Wp = 3 * w + PAD;
+		if(RGB==NULL)
+			RGB=(unsigned char *)calloc(Wp*h,sizeof(unsigned char));
+		if(RGB==NULL || !image_alloc(&in[i],h,w) || !image_alloc(&out[i],h,w)){
+			puts("Cannot allocate image planes");
+			exit(1);
 		}
-	}
-	
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
-
-////////////	File 6 	//////////
-
-	read[0]=fopen("blue_read.sh","w");
-	read[1]=fopen("green_read.sh","w");
-	read[2]=fopen("red_read.sh","w");
-	if(read[0]==NULL || read[1]==NULL || read[2]==NULL)
-	{
-		puts("Cannot open read file");
-		exit(1);
-	}
-	fprintf(read[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-
-
-	fprintf(read[0],"./win32/rel/flcli -v 1443:0007 -a \"r6 1c3a \\\"blue_write.txt\\\"\"");
-	fprintf(read[1],"./win32/rel/flcli -v 1443:0007 -a \"r16 1c3a \\\"green_write.txt\\\"\"");
-	fprintf(read[2],"./win32/rel/flcli -v 1443:0007 -a \"r26 1c3a \\\"red_write.txt\\\"\"");
-
-	fclose(read[0]);
-	fclose(read[1]);
-	fclose(read[2]);
-
-	//Read data from FPGA
-	
-	system(cmd0);
-	system(cmd1);
-	system(cmd2);
-
-	//Read from text file and write to image
-	outputfinal[0]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\blue_write.txt","rb");
-	outputfinal[1]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\green_write.txt","rb");
-	outputfinal[2]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\red_write.txt","rb");
-	if(outputfinal[0]==NULL || outputfinal[1]==NULL || outputfinal[1]==NULL)
-	{
-		puts("Cannot open output file");
-		exit(1);
-	}
-
-	;
-
-	unsigned char hexb5[8000] ="";
-	unsigned char hexg5[8000] ="";
-	unsigned char hexr5[8000] ="";
-	
-    bytesb = 0;
-    bytesb = fread ( &hexb5, 1, 8000, outputfinal[0]);
-	
-    bytesg = 0;
-    bytesg = fread ( &hexg5, 1, 8000, outputfinal[1]);
-	
-    bytesr = 0;
-    bytesr = fread ( &hexr5, 1, 8000, outputfinal[2]);
-
-    b=g=r=1;
-	for (i = 2; i < H; i+=3){
-		for (j = 1; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			RGB[i1] = (int)(hexb5[b++]); 
-			RGB[i1+1] = (int)(hexg5[g++]);
-			RGB[i1+2] = (int)(hexr5[r++]);
+		f=fopen(frames[i],"r");
+		fseek(f,bmp.bOffBits,SEEK_SET);
+		fread(RGB,sizeof(unsigned char),Wp*h,f);
+		fclose(f);
+		image_from_bgr(&in[i],RGB,Wp);
+		image_copy(&out[i],&in[i]);
+	}
+
+	roi_clip(&roi,h,w,&roi);
+	roi_halo(&roi,h,w,&win);
+	/* fin and fout are the frames left to filter, the daemon has a
+	 * backend of its own */
+	for(i=0,m=0;i<n;i++){
+		if(cache_dir!=NULL){
+			int params[5]={roi.x,roi.y,roi.w,roi.h,
+				result_producer(daemon_path!=NULL ? "daemon" : backend_name())};
+			result_key_init(&key[i],RESULT_LOWPASS,params,5);
+			result_key_image(&key[i],&in[i],planes);
+			if(result_cache_get_image(&cache,&key[i],&out[i],planes))
+				continue;
 		}
-	}
-
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
-
-////////////	File 7 	//////////
-
-	read[0]=fopen("blue_read.sh","w");
-	read[1]=fopen("green_read.sh","w");
-	read[2]=fopen("red_read.sh","w");
-	if(read[0]==NULL || read[1]==NULL || read[2]==NULL)
-	{
-		puts("Cannot open read file");
-		exit(1);
-	}
-	fprintf(read[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-
-
-	fprintf(read[0],"./win32/rel/flcli -v 1443:0007 -a \"r7 1c8f \\\"blue_write.txt\\\"\"");
-	fprintf(read[1],"./win32/rel/flcli -v 1443:0007 -a \"r17 1c8f \\\"green_write.txt\\\"\"");
-	fprintf(read[2],"./win32/rel/flcli -v 1443:0007 -a \"r27 1c8f \\\"red_write.txt\\\"\"");
-
-	fclose(read[0]);
-	fclose(read[1]);
-	fclose(read[2]);
-
-	//Read data from FPGA
-	
-	system(cmd0);
-	system(cmd1);
-	system(cmd2);
-
-	//Read from text file and write to image
-	outputfinal[0]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\blue_write.txt","rb");
-	outputfinal[1]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\green_write.txt","rb");
-	outputfinal[2]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\red_write.txt","rb");
-	if(outputfinal[0]==NULL || outputfinal[1]==NULL || outputfinal[1]==NULL)
-	{
-		puts("Cannot open output file");
-		exit(1);
-	}
-
-	;
-
-	unsigned char hexb6[8000] ="";
-	unsigned char hexg6[8000] ="";
-	unsigned char hexr6[8000] ="";
-	
-    bytesb = 0;
-    bytesb = fread ( &hexb6, 1, 8000, outputfinal[0]);
-	
-    bytesg = 0;
-    bytesg = fread ( &hexg6, 1, 8000, outputfinal[1]);
-	
-    bytesr = 0;
-    bytesr = fread ( &hexr6, 1, 8000, outputfinal[2]);
-
-    b=g=r=1;
-	for (i = 0; i < H; i+=3){
-		for (j = 2; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			RGB[i1] = (int)(hexb6[b++]); 
-			RGB[i1+1] = (int)(hexg6[g++]);
-			RGB[i1+2] = (int)(hexr6[r++]);
+		key[m]=key[i];
+		fin[m]=in[i];
+		fout[m++]=out[i];
+	}
+	if(m==0)
+		nboards=0;
+	else if(daemon_path!=NULL){
+		/* the daemon has the board open already */
+		if(!daemon_lowpass(daemon_path,fin,fout,m,&roi,planes,coded,error)){
+			printf("Cannot filter the frames: %s\n",error);
+			exit(1);
 		}
-	}
-
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
-
-////////////	File 8 	//////////
-
-	read[0]=fopen("blue_read.sh","w");
-	read[1]=fopen("green_read.sh","w");
-	read[2]=fopen("red_read.sh","w");
-	if(read[0]==NULL || read[1]==NULL || read[2]==NULL)
-	{
-		puts("Cannot open read file");
-		exit(1);
-	}
-	fprintf(read[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-
-
-	fprintf(read[0],"./win32/rel/flcli -v 1443:0007 -a \"r8 1c3a \\\"blue_write.txt\\\"\"");
-	fprintf(read[1],"./win32/rel/flcli -v 1443:0007 -a \"r18 1c3a \\\"green_write.txt\\\"\"");
-	fprintf(read[2],"./win32/rel/flcli -v 1443:0007 -a \"r28 1c3a \\\"red_write.txt\\\"\"");
-
-	fclose(read[0]);
-	fclose(read[1]);
-	fclose(read[2]);
-
-	//Read data from FPGA
-	
-	system(cmd0);
-	system(cmd1);
-	system(cmd2);
-
-	//Read from text file and write to image
-	outputfinal[0]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\blue_write.txt","rb");
-	outputfinal[1]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\green_write.txt","rb");
-	outputfinal[2]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\red_write.txt","rb");
-	if(outputfinal[0]==NULL || outputfinal[1]==NULL || outputfinal[1]==NULL)
-	{
-		puts("Cannot open output file");
-		exit(1);
-	}
-
-	;
-	
-	unsigned char hexb7[8000] ="";
-	unsigned char hexg7[8000] ="";
-	unsigned char hexr7[8000] ="";
-
-	
-    bytesb = 0;
-    bytesb = fread ( &hexb7, 1, 8000, outputfinal[0]);
-	
-    bytesg = 0;
-    bytesg = fread ( &hexg7, 1, 8000, outputfinal[1]);
-	
-    bytesr = 0;
-    bytesr = fread ( &hexr7, 1, 8000, outputfinal[2]);
-
-    b=g=r=1;
-	for (i = 1; i < H; i+=3){
-		for (j = 2; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			RGB[i1] = (int)(hexb7[b++]); 
-			RGB[i1+1] = (int)(hexg7[g++]);
-			RGB[i1+2] = (int)(hexr7[r++]);
+		nboards=0;
+	}
+	else{
+		pipeline_tile_size(&win,&tw,&th);
+		printf("%ld tiles of %d x %d a frame\n",pipeline_tiles(&roi,h,w,tw,th,NULL),tw,th);
+		nboards=open_fpga(board,nboards);
+		if(tune_file!=NULL)
+			autotune(board,nboards,fin,fout,m);
+		if(!pipeline_lowpass(board,nboards,fin,fout,m,&roi,planes,done,coded ? &coding : NULL)){
+			for(i=0;i<nboards;i++)
+				if(board[i].error!=NULL)
+					printf("Cannot filter the frames on board %d: %s\n",i,board[i].error);
+			exit(1);
 		}
+		if(nboards>1)
+			for(i=0;i<nboards;i++)
+				printf("board %d: %ld tiles\n",i,done[i]);
+		print_coding();
+	}
+	if(cache_dir!=NULL)
+		for(i=0;i<m;i++)
+			result_cache_put_image(&cache,&key[i],&fout[i],planes);
+
+	for(i=0;i<n;i++){
+		memset(RGB,0,Wp*h);
+		image_select(&view,&out[i],planes);
+		image_to_bgr(&view,RGB,Wp);
+		if(verify)
+			verify_output(&in[i],RGB,Wp,&bmp);
+		if(n==1)
+			strcpy(outname,"lowpass.bmp");
+		else
+			sprintf(outname,"lowpass%03d.bmp",i);
+		f=fopen(outname,"wb");
+		fwrite(&bmp.bType,sizeof(unsigned short),1,f);
+		fwrite((int *)&bmp+1,sizeof(BMP)-4,1,f);
+		fseek(f,bmp.bOffBits,SEEK_SET);
+		fwrite(RGB,sizeof(unsigned char),Wp*h,f);
+		fclose(f);
+		image_free(&in[i]);
+		image_free(&out[i]);
 	}
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
-
-////////////	File 9 	//////////
-
-	read[0]=fopen("blue_read.sh","w");
-	read[1]=fopen("green_read.sh","w");
-	read[2]=fopen("red_read.sh","w");
-	if(read[0]==NULL || read[1]==NULL || read[2]==NULL)
-	{
-		puts("Cannot open read file");
-		exit(1);
-	}
-	fprintf(read[0],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[1],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(read[2],"cd C:/makestuff/libs/libfpgalink-20120621\n");
-
-
-	fprintf(read[0],"./win32/rel/flcli -v 1443:0007 -a \"r9 1c3a \\\"blue_write.txt\\\"\"");
-	fprintf(read[1],"./win32/rel/flcli -v 1443:0007 -a \"r19 1c3a \\\"green_write.txt\\\"\"");
-	fprintf(read[2],"./win32/rel/flcli -v 1443:0007 -a \"r29 1c3a \\\"red_write.txt\\\"\"");
-
-	fclose(read[0]);
-	fclose(read[1]);
-	fclose(read[2]);
-
-	//Read data from FPGA
-	
-	system(cmd0);
-	system(cmd1);
-	system(cmd2);
-
-	//Read from text file and write to image
-	outputfinal[0]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\blue_write.txt","rb");
-	outputfinal[1]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\green_write.txt","rb");
-	outputfinal[2]=fopen("C:\\makestuff\\libs\\libfpgalink-20120621\\red_write.txt","rb");
-	if(outputfinal[0]==NULL || outputfinal[1]==NULL || outputfinal[1]==NULL)
-	{
-		puts("Cannot open output file");
-		exit(1);
-	}
-
-	unsigned char hexb8[8000] ="";
-	unsigned char hexg8[8000] ="";
-	unsigned char hexr8[8000] ="";
-
-	
-    bytesb = 0;
-    bytesb = fread ( &hexb8, 1, 8000, outputfinal[0]);
-	
-    bytesg = 0;
-    bytesg = fread ( &hexg8, 1, 8000, outputfinal[1]);
-	
-    bytesr = 0;
-    bytesr = fread ( &hexr8, 1, 8000, outputfinal[2]);
-
-    b=g=r=1;
-	for (i = 2; i < H; i+=3){
-		for (j = 2; j < W; j+=3){
-			i1=i*(Wp)+j*3;
-			RGB[i1] = (int)(hexb8[b++]); 
-			RGB[i1+1] = (int)(hexg8[g++]);
-			RGB[i1+2] = (int)(hexr8[r++]);
-		}
-	}
-
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
-//	for(i=0;i<256;i++)
-//	printf("%d ",RGB[i]);
-
-	fwrite(RGB, sizeof(unsigned char), Wp * H, f);
-	fclose(f);
-	fclose(outputfinal[0]);
-	fclose(outputfinal[1]);
-	fclose(outputfinal[2]);
 	free(RGB);
+	free(in);
+	free(out);
+	free(fin);
+	free(fout);
+	free(key);
 }
 
+void write_stats(FPGA *f,int n)
+{
+	FILE *out;
+	if(stats_file==NULL)
+		return;
+	out=fopen(stats_file,"w");
+	if(out==NULL){
+		printf("Cannot write %s\n",stats_file);
+		return;
+	}
+	fpga_stats_json(f,n,out);
+	fclose(out);
+}
 
-int main(){
+int main(int argc, char **argv){
 
 	int PERFORM;
 	int h,w;
 	BMP b;
 	int i,j;
 	BMP *bmp=&b;
+	char **frames=(char **)malloc(argc*sizeof(char *));
+	int nframes=0;
+
+	for(i=1;i<argc;i++){
+		if(strcmp(argv[i],"-r")==0 && i+4<argc){
+			/* filter only columns x..x+w-1 of rows y..y+h-1 */
+			roi.x=atoi(argv[++i]);
+			roi.y=atoi(argv[++i]);
+			roi.w=atoi(argv[++i]);
+			roi.h=atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i],"-v")==0)
+			verify=1;
+		else if(strcmp(argv[i],"-c")==0 && i+1<argc){
+			/* e.g. -c r moves only the red plane */
+			planes=plane_mask(argv[++i]);
+			if(!planes){
+				puts("-c takes a combination of the letters r, g and b");
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i],"-B")==0 && i+1<argc)
+			backend=argv[++i];	/* fpgalink, flcli, flcli-pipe, loopback, emulator or replay */
+		else if(strcmp(argv[i],"-L")==0 && i+1<argc)
+			link_model=argv[++i];	/* e.g. -L 20:125 for 20 MB/s and 125 us */
+		else if(strcmp(argv[i],"-J")==0 && i+1<argc)
+			stats_file=argv[++i];	/* bytes, MB/s and latencies of the transfers */
+		else if(strcmp(argv[i],"-z")==0)
+			coded=1;
+		else if(strcmp(argv[i],"-D")==0 && i+1<argc)
+			daemon_path=argv[++i];	/* send the frames to fpga_daemon on this socket */
+		else if(strcmp(argv[i],"-T")==0 && i+1<argc)
+			trace_file=argv[++i];	/* record the channel traffic */
+		else if(strcmp(argv[i],"-C")==0 && i+1<argc)
+			cache_dir=argv[++i];	/* frames filtered before are not sent again */
+		else if(strcmp(argv[i],"-A")==0 && i+1<argc)
+			tune_file=argv[++i];	/* find the fastest transfer shape and save it */
+		else if(strcmp(argv[i],"-S")==0 && i+1<argc)
+			shape_file=argv[++i];
+		else if(strcmp(argv[i],"-R")==0 && i+1<argc)
+			replay=argv[++i];	/* e.g. -R trace.bin@10 plays it 10 times faster */
+		else if(strcmp(argv[i],"-n")==0 && i+1<argc){
+			/* share the tiles among up to n boards */
+			nboards=atoi(argv[++i]);
+			if(nboards<1 || nboards>FPGA_BOARDS_MAX){
+				printf("-n takes 1 to %d boards\n",FPGA_BOARDS_MAX);
+				return 1;
+			}
+		}
+		else if(argv[i][0]!='-')
+			frames[nframes++]=argv[i];
+		else{
+			printf("usage: %s [-B backend] [-L MBps:us] [-n boards] [-J stats.json] [-z] [-D socket] [-T trace] [-R trace[@speed]] [-C dir|-] [-A shape] [-S shape] [-c rgb] [-r x y w h] [-v] [frame.bmp ...]\n",argv[0]);
+			return 1;
+		}
+	}
+
+	if(nframes==0)
+		frames[nframes++]="test.bmp";
+	if(shape_file!=NULL){
+		PIPE_SHAPE shape;
+		if(!pipeline_shape_load(shape_file,&shape)){
+			printf("Cannot read %s\n",shape_file);
+			return 1;
+		}
+		pipeline_set_shape(&shape);
+		printf("transfers in chunks of %lu bytes, %s order\n",(unsigned long)shape.chunk,
+			pipeline_order_name(shape.order));
+	}
+	if(!Read_BMP_Header(frames[0],&h,&w,bmp))
+		return 1;
+	/* a window whose phases do not fit the BRAMs or with a side over
+	 * PIPE_WINDOW_MAX goes in tiles */
+	roi_clip(&roi,h,w,&win);
+	roi_halo(&win,h,w,&win);
+	if(nframes>1 || nboards>1 || daemon_path!=NULL || cache_dir!=NULL || tune_file!=NULL || shape_file!=NULL || !pipeline_fits(&win,PIPE_BRAM_DEPTH)){
+		if(cache_dir!=NULL)
+			result_cache_init(&cache,RESULT_CACHE_MEM,cache_dir);
+		lowpass_frames(frames,nframes);
+		if(cache_dir!=NULL){
+			result_cache_stats(&cache,stdout);
+			result_cache_free(&cache);
+		}
+		write_stats(board,nboards);
+		for(i=0;i<nboards;i++)
+			fpga_close(&board[i]);
+		free(frames);
+		return 0;
+	}
 
-	Read_BMP_Header("test.bmp",&h,&w,bmp);
-	Read_BMP_Data("test.bmp",&h,&w,bmp);
+	Read_BMP_Data(frames[0],&h,&w,bmp);
 
 
 	write_BMP_Header("lowpass.bmp",&h,&w,bmp);
 	write_BMP_Data("lowpass.bmp",&h,&w,bmp);
+	write_stats(&fpga,1);
+	fpga_close(&fpga);
+	image_free(&img);
+	free(frames);
 	printf("\n");
 	return 0;
 }
@@ -0,0 +1,169 @@
+#include <string.h>
+#include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "morphology.h"
+
+/* columns per thread in the vertical pass */
+#define MORPH_BAND 64
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+int morph_op(const char *name)
+{
+	if(strcmp(name,"erode")==0) return MORPH_ERODE;
+	if(strcmp(name,"dilate")==0) return MORPH_DILATE;
+	if(strcmp(name,"open")==0) return MORPH_OPEN;
+	if(strcmp(name,"close")==0) return MORPH_CLOSE;
+	return -1;
+}
+
+/* d = min(a,b) or max(a,b) over n bytes */
+static void vop(unsigned char *d, const unsigned char *a, const unsigned char *b, int n, int dilate)
+{
+	int j = 0;
+#ifdef __SSE2__
+	if(dilate)
+		for(;j+16<=n;j+=16)
+			_mm_storeu_si128((__m128i *)(d+j), _mm_max_epu8(_mm_loadu_si128((const __m128i *)(a+j)),
+						_mm_loadu_si128((const __m128i *)(b+j))));
+	else
+		for(;j+16<=n;j+=16)
+			_mm_storeu_si128((__m128i *)(d+j), _mm_min_epu8(_mm_loadu_si128((const __m128i *)(a+j)),
+						_mm_loadu_si128((const __m128i *)(b+j))));
+#endif
+	if(dilate)
+		for(;j<n;j++) d[j] = MAX(a[j],b[j]);
+	else
+		for(;j<n;j++) d[j] = MIN(a[j],b[j]);
+}
+
+/* The input is padded to L = len+k-1 positions, position p holding input
+ * p-k/2 or the neutral value. g is the running extremum from the start of
+ * each block of k positions, h the running extremum to its end; the window
+ * starting at p is then op(h[p], g[p+k-1]). */
+
+/* along one row */
+static void hgw_row(const unsigned char *s, unsigned char *d, int W, int k, int dilate,
+		unsigned char *g, unsigned char *h)
+{
+	int a = k / 2, L = W + k - 1, p;
+	unsigned char id = dilate ? 0 : 255, f;
+
+	for(p=0;p<L;p++){
+		f = p-a >= 0 && p-a < W ? s[p-a] : id;
+		g[p] = p % k == 0 ? f : dilate ? MAX(g[p-1],f) : MIN(g[p-1],f);
+	}
+	for(p=L-1;p>=0;p--){
+		f = p-a >= 0 && p-a < W ? s[p-a] : id;
+		h[p] = p % k == k-1 || p == L-1 ? f : dilate ? MAX(h[p+1],f) : MIN(h[p+1],f);
+	}
+	for(p=0;p<W;p++)
+		d[p] = dilate ? MAX(h[p],g[p+k-1]) : MIN(h[p],g[p+k-1]);
+}
+
+/* down n columns at once, each step works on a row segment with vop */
+static void hgw_band(const unsigned char *src, unsigned char *dst, int H, int W, int n, int k, int dilate,
+		unsigned char *g, unsigned char *h, const unsigned char *idrow)
+{
+	int a = k / 2, L = H + k - 1, p;
+#define ROW(p) ((p)-a >= 0 && (p)-a < H ? src + (size_t)((p)-a) * W : idrow)
+
+	for(p=0;p<L;p++){
+		if(p % k == 0)
+			memcpy(g + (size_t)p * n, ROW(p), n);
+		else
+			vop(g + (size_t)p * n, g + (size_t)(p-1) * n, ROW(p), n, dilate);
+	}
+	for(p=L-1;p>=0;p--){
+		if(p % k == k-1 || p == L-1)
+			memcpy(h + (size_t)p * n, ROW(p), n);
+		else
+			vop(h + (size_t)p * n, h + (size_t)(p+1) * n, ROW(p), n, dilate);
+	}
+	for(p=0;p<H;p++)
+		vop(dst + (size_t)p * W, h + (size_t)p * n, g + (size_t)(p+k-1) * n, n, dilate);
+#undef ROW
+}
+
+/* erosion or dilation, rows first into tmp then columns into dst. 0 when
+ * a thread had no buffers */
+static int extremum(const unsigned char *src, unsigned char *dst, unsigned char *tmp,
+		int H, int W, int kw, int kh, int dilate)
+{
+	int nb = (W + MORPH_BAND - 1) / MORPH_BAND, ok = 1;
+
+	#pragma omp parallel reduction(&&:ok)
+	{
+		unsigned char *g = (unsigned char *)malloc((size_t)(W + kw - 1) * 2);
+		unsigned char *vg = (unsigned char *)malloc((size_t)(H + kh - 1) * MORPH_BAND * 2 + MORPH_BAND);
+		unsigned char *vh = NULL, *idrow = NULL;
+		int i,b;
+
+		if(vg!=NULL){
+			vh = vg + (size_t)(H + kh - 1) * MORPH_BAND;
+			idrow = vh + (size_t)(H + kh - 1) * MORPH_BAND;
+			memset(idrow, dilate ? 0 : 255, MORPH_BAND);
+		}
+		ok = g!=NULL && vg!=NULL;
+
+		/* every thread has to reach both loops, even without its buffers */
+		#pragma omp for schedule(static)
+		for(i=0;i<H;i++)
+			if(g!=NULL)
+				hgw_row(src + (size_t)i * W, tmp + (size_t)i * W, W, kw, dilate, g, g + W + kw - 1);
+
+		#pragma omp for schedule(static)
+		for(b=0;b<nb;b++){
+			int c0 = b * MORPH_BAND;
+			int n = c0 + MORPH_BAND > W ? W - c0 : MORPH_BAND;
+			if(vg!=NULL)
+				hgw_band(tmp + c0, dst + c0, H, W, n, kh, dilate, vg, vh, idrow);
+		}
+		free(g);
+		free(vg);
+	}
+	return ok;
+}
+
+int morph_plane(const unsigned char *src, unsigned char *dst, int H, int W, int op, int kw, int kh)
+{
+	size_t n = (size_t)H * W;
+	unsigned char *tmp = (unsigned char *)malloc(op == MORPH_OPEN || op == MORPH_CLOSE ? 2 * n : n);
+	int ok = 1;
+
+	if(tmp==NULL)
+		return 0;
+	if(kw < 1) kw = 1;
+	if(kh < 1) kh = 1;
+	switch(op){
+	case MORPH_ERODE:
+		ok = extremum(src, dst, tmp, H, W, kw, kh, 0);
+		break;
+	case MORPH_DILATE:
+		ok = extremum(src, dst, tmp, H, W, kw, kh, 1);
+		break;
+	case MORPH_OPEN:
+		ok = extremum(src, tmp + n, tmp, H, W, kw, kh, 0)
+			&& extremum(tmp + n, dst, tmp, H, W, kw, kh, 1);
+		break;
+	case MORPH_CLOSE:
+		ok = extremum(src, tmp + n, tmp, H, W, kw, kh, 1)
+			&& extremum(tmp + n, dst, tmp, H, W, kw, kh, 0);
+		break;
+	}
+	free(tmp);
+	return ok;
+}
+
+int morph_image(const IMAGE *src, IMAGE *dst, int op, int kw, int kh)
+{
+	int k;
+	for(k=0;k<NUM_PLANES;k++)
+		if(src->plane[k]!=NULL && !morph_plane(src->plane[k], dst->plane[k], src->H, src->W, op, kw, kh))
+			return 0;
+	return 1;
+}
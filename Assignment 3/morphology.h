@@ -0,0 +1,25 @@
+/* Grayscale erosion, dilation, opening and closing of 8-bit planes with a
+ * kw x kh rectangle. Each direction is done separately with the van Herk /
+ * Gil-Werman prefix/suffix maximum, three min or max operations per pixel
+ * whatever the rectangle size. Pixels outside the frame are ignored.
+ */
+
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+#include "image.h"
+
+#define MORPH_ERODE  0
+#define MORPH_DILATE 1
+#define MORPH_OPEN   2
+#define MORPH_CLOSE  3
+
+/* returns the operation for "erode", "dilate", "open" or "close", else -1 */
+int morph_op(const char *name);
+
+/* return 1, or 0 when the buffers cannot be allocated and dst is not
+ * complete */
+int morph_plane(const unsigned char *src, unsigned char *dst, int H, int W, int op, int kw, int kh);
+int morph_image(const IMAGE *src, IMAGE *dst, int op, int kw, int kh);
+
+#endif
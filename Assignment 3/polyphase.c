@@ -0,0 +1,141 @@
+#include <string.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "polyphase.h"
+
+size_t polyphase_len(const ROI *win, int k, int pi, int pj)
+{
+	return (size_t)PHASE_LEN(win->h, k, pi) * PHASE_LEN(win->w, k, pj);
+}
+
+#ifdef __SSSE3__
+/* byte m of the output is byte m*k of the input, which lies in the
+ * 16-byte load m*k/16. mask[l] picks the lanes load l contributes. */
+static void split_masks(int k, __m128i *mask)
+{
+	unsigned char b[16];
+	int l, m;
+	for(l=0;l<k;l++){
+		for(m=0;m<16;m++)
+			b[m] = m*k/16 == l ? (unsigned char)(m*k%16) : 0x80;
+		mask[l] = _mm_loadu_si128((const __m128i *)b);
+	}
+}
+
+/* the inverse: byte t of output vector l is element (16l+t)/k of phase
+ * (16l+t)%k, mask[l*k + p] picks the lanes phase p contributes */
+static void merge_masks(int k, __m128i *mask)
+{
+	unsigned char b[16];
+	int l, p, t;
+	for(l=0;l<k;l++)
+		for(p=0;p<k;p++){
+			for(t=0;t<16;t++)
+				b[t] = (16*l+t)%k == p ? (unsigned char)((16*l+t)/k) : 0x80;
+			mask[l*k + p] = _mm_loadu_si128((const __m128i *)b);
+		}
+}
+#endif
+
+void polyphase_scatter(const unsigned char *plane, int W, const ROI *win, int k, int pi, int pj,
+		unsigned char *dst)
+{
+	int rows = PHASE_LEN(win->h, k, pi), cols = PHASE_LEN(win->w, k, pj), r;
+	int x0 = win->x + pj;
+#ifdef __SSSE3__
+	__m128i mask[POLYPHASE_MAX_K];
+	/* a vector reads 16*k bytes, which must stay inside the row */
+	int nv = (W - x0) / (16 * k);
+	if(nv > cols / 16)
+		nv = cols / 16;
+	split_masks(k, mask);
+#endif
+
+	#pragma omp parallel for schedule(static)
+	for(r=0;r<rows;r++){
+		const unsigned char *s = plane + (size_t)(win->y + pi + k*r) * W + x0;
+		unsigned char *d = dst + (size_t)r * cols;
+		int c = 0;
+#ifdef __SSSE3__
+		int v, l;
+		for(v=0;v<nv;v++,c+=16){
+			__m128i x = _mm_setzero_si128();
+			for(l=0;l<k;l++)
+				x = _mm_or_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 16*(k*v + l))), mask[l]));
+			_mm_storeu_si128((__m128i *)(d+c), x);
+		}
+#endif
+		for(;c<cols;c++)
+			d[c] = s[c*k];
+	}
+}
+
+int polyphase_gather(unsigned char *const *phase, unsigned char *out, size_t stride, int step,
+		const ROI *win, const ROI *roi, int k)
+{
+	size_t len = (size_t)win->w + 16 * k;
+	int cols[POLYPHASE_MAX_K], p, threads = 1;
+	unsigned char *rows;
+#ifdef __SSSE3__
+	__m128i mask[POLYPHASE_MAX_K * POLYPHASE_MAX_K];
+	merge_masks(k, mask);
+#endif
+
+	for(p=0;p<k;p++)
+		cols[p] = PHASE_LEN(win->w, k, p);
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	/* a row of each thread, where one window row is interleaved before its
+	 * roi part is copied */
+	rows = (unsigned char *)malloc(len * threads);
+	if(rows==NULL)
+		return 0;
+
+	#pragma omp parallel num_threads(threads)
+	{
+		unsigned char *row = rows;
+		int i;
+#ifdef _OPENMP
+		row += len * omp_get_thread_num();
+#endif
+
+		#pragma omp for schedule(static)
+		for(i=roi->y;i<roi->y+roi->h;i++){
+			int pi = (i - win->y) % k, r = (i - win->y) / k, j = 0, q;
+			const unsigned char *s[POLYPHASE_MAX_K];
+			for(q=0;q<k;q++)
+				s[q] = phase[pi + k*q] + (size_t)r * cols[q];
+#ifdef __SSSE3__
+			/* the last phase is the shortest, all have 16 more elements */
+			for(q=0;16*(q+1)<=cols[k-1];q++,j+=16*k){
+				int l, m;
+				for(l=0;l<k;l++){
+					__m128i x = _mm_setzero_si128();
+					for(m=0;m<k;m++)
+						x = _mm_or_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s[m] + 16*q)), mask[l*k + m]));
+					_mm_storeu_si128((__m128i *)(row + j + 16*l), x);
+				}
+			}
+#endif
+			for(;j<win->w;j++)
+				row[j] = s[j%k][j/k];
+			if(step == 1)
+				memcpy(out + (size_t)i * stride + roi->x, row + roi->x - win->x, roi->w);
+			else{
+				unsigned char *d = out + (size_t)i * stride + (size_t)roi->x * step;
+				const unsigned char *s = row + roi->x - win->x;
+				for(j=0;j<roi->w;j++)
+					d[(size_t)j * step] = s[j];
+			}
+		}
+	}
+	free(rows);
+	return 1;
+}
@@ -0,0 +1,33 @@
+/* Polyphase split of a plane window into k x k phases and back.
+ * Phase (pi,pj) holds the pixels (win.y + pi + k*r, win.x + pj + k*c) of
+ * the window, row by row. It is phase number pi + k*pj, the order of the
+ * BRAMs in top_level_27.vhdl for k = 3. Lengths follow from the window
+ * size, so any frame size works.
+ */
+
+#ifndef POLYPHASE_H
+#define POLYPHASE_H
+
+#include <stddef.h>
+#include "box_filter.h"
+
+#define POLYPHASE_MAX_K 16	/* the SIMD paths handle k up to 16 */
+
+/* samples of phase p when n samples are split k ways */
+#define PHASE_LEN(n,k,p) ((n) > (p) ? ((n) - (p) + (k) - 1) / (k) : 0)
+
+/* bytes of phase (pi,pj) of win */
+size_t polyphase_len(const ROI *win, int k, int pi, int pj);
+
+/* copy phase (pi,pj) of win from a plane with row stride W into dst */
+void polyphase_scatter(const unsigned char *plane, int W, const ROI *win, int k, int pi, int pj,
+		unsigned char *dst);
+/* interleave all k*k phases of win, phase[pi + k*pj], back into out, whose
+ * rows are stride bytes apart and pixels step bytes apart (1 for a plane,
+ * 3 for one colour of BGR rows). Only the pixels inside roi, which must lie
+ * in win, are written. Returns 0 when its row buffers cannot be allocated,
+ * nothing is written then */
+int polyphase_gather(unsigned char *const *phase, unsigned char *out, size_t stride, int step,
+		const ROI *win, const ROI *roi, int k);
+
+#endif
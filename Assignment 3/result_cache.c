@@ -0,0 +1,332 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define mkdir(dir, mode) _mkdir(dir)
+#define getpid _getpid
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "result_cache.h"
+
+#define RESULT_MAGIC "RC01"
+#define RESULT_BUCKETS_MIN 256
+#define P1 0x9e3779b97f4a7c15ULL
+#define P2 0xc2b2ae3d27d4eb4fULL
+
+static unsigned long long rotl(unsigned long long v, int r)
+{
+	return v << r | v >> (64 - r);
+}
+
+static unsigned long long fmix(unsigned long long h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	return h ^ h >> 33;
+}
+
+void result_key_init(RESULT_KEY *k, int kind, const int *params, int nparams)
+{
+	k->a = P1 ^ (unsigned)kind;
+	k->b = P2 + (unsigned)nparams;
+	if(nparams > 0)
+		result_key_add(k, params, nparams*sizeof(int));
+}
+
+int result_producer(const char *name)
+{
+	unsigned h = 2166136261u;
+	if(name == NULL)
+		return 0;
+	while(*name)
+		h = (h ^ (unsigned char)*name++) * 16777619u;
+	return (int)(h >> 1 | 1);
+}
+
+/* two lanes of 8 bytes a step, about a byte a cycle */
+void result_key_add(RESULT_KEY *k, const void *data, size_t n)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	unsigned long long a = k->a ^ n * P1, b = k->b + n, v;
+	size_t i;
+
+	for(i=0;i+8<=n;i+=8){
+		memcpy(&v, p + i, 8);
+		a = rotl(a ^ v * P2, 31) * P1;
+		b = rotl(b + v, 27) * P2 + a;
+	}
+	v = 0;
+	memcpy(&v, p + i, n - i);
+	a ^= v * P2;
+	b += v;
+	k->a = fmix(a + b);
+	k->b = fmix(b ^ rotl(a, 17));
+}
+
+void result_key_image(RESULT_KEY *k, const IMAGE *img, int planes)
+{
+	int p;
+	result_key_add(k, &img->H, sizeof(int));
+	result_key_add(k, &img->W, sizeof(int));
+	result_key_add(k, &planes, sizeof(int));
+	for(p=0;p<NUM_PLANES;p++)
+		if(planes & (1<<p))
+			result_key_add(k, img->plane[p], (size_t)img->H*img->W);
+}
+
+void result_cache_init(RESULT_CACHE *c, size_t max_bytes, const char *dir)
+{
+	memset(c, 0, sizeof(*c));
+	c->max_bytes = max_bytes;
+	if(dir != NULL && strcmp(dir, "-") != 0){
+		snprintf(c->dir, sizeof(c->dir), "%s", dir);
+		mkdir(c->dir, 0755);
+	}
+}
+
+static void unlink_entry(RESULT_CACHE *c, RESULT_ENTRY *e)
+{
+	if(e->prev != NULL)
+		e->prev->next = e->next;
+	else
+		c->head = e->next;
+	if(e->next != NULL)
+		e->next->prev = e->prev;
+	else
+		c->tail = e->prev;
+}
+
+static void push_front(RESULT_CACHE *c, RESULT_ENTRY *e)
+{
+	e->prev = NULL;
+	e->next = c->head;
+	if(c->head != NULL)
+		c->head->prev = e;
+	c->head = e;
+	if(c->tail == NULL)
+		c->tail = e;
+}
+
+void result_cache_free(RESULT_CACHE *c)
+{
+	while(c->head != NULL){
+		RESULT_ENTRY *e = c->head;
+		c->head = e->next;
+		free(e->data);
+		free(e);
+	}
+	free(c->bucket);
+	c->bucket = NULL;
+	c->nbuckets = c->count = 0;
+	c->tail = NULL;
+	c->bytes = 0;
+}
+
+/* the keys are hashes already, the low bits of a pick the bucket */
+static RESULT_ENTRY **bucket_of(const RESULT_CACHE *c, const RESULT_KEY *k)
+{
+	return &c->bucket[k->a & (c->nbuckets - 1)];
+}
+
+static RESULT_ENTRY *find(RESULT_CACHE *c, const RESULT_KEY *k)
+{
+	RESULT_ENTRY *e;
+	if(c->nbuckets == 0)
+		return NULL;
+	for(e=*bucket_of(c, k);e!=NULL;e=e->chain)
+		if(e->key.a == k->a && e->key.b == k->b)
+			return e;
+	return NULL;
+}
+
+/* twice the buckets once there are as many entries, 0 when there are
+ * none and no memory for them */
+static int grow(RESULT_CACHE *c)
+{
+	size_t n = c->nbuckets ? 2*c->nbuckets : RESULT_BUCKETS_MIN;
+	RESULT_ENTRY **b, *e;
+
+	if(c->count < c->nbuckets)
+		return 1;
+	b = (RESULT_ENTRY **)calloc(n, sizeof(RESULT_ENTRY *));
+	if(b == NULL)
+		return c->nbuckets > 0;	/* longer chains then */
+	free(c->bucket);
+	c->bucket = b;
+	c->nbuckets = n;
+	for(e=c->head;e!=NULL;e=e->next){
+		RESULT_ENTRY **h = bucket_of(c, &e->key);
+		e->chain = *h;
+		*h = e;
+	}
+	return 1;
+}
+
+static void drop_entry(RESULT_CACHE *c, RESULT_ENTRY *e)
+{
+	RESULT_ENTRY **h = bucket_of(c, &e->key);
+	while(*h != e)
+		h = &(*h)->chain;
+	*h = e->chain;
+	unlink_entry(c, e);
+	c->count--;
+	c->bytes -= e->n;
+	free(e->data);
+	free(e);
+}
+
+/* into the memory tier only, evicting from the tail */
+static void remember(RESULT_CACHE *c, const RESULT_KEY *k, const void *data, size_t n)
+{
+	RESULT_ENTRY *e;
+
+	if(n > c->max_bytes || find(c, k) != NULL)
+		return;
+	while(c->bytes + n > c->max_bytes && c->tail != NULL){
+		drop_entry(c, c->tail);
+		c->evictions++;
+	}
+	if(!grow(c))
+		return;
+	e = (RESULT_ENTRY *)malloc(sizeof(RESULT_ENTRY));
+	if(e == NULL)
+		return;
+	e->data = (unsigned char *)malloc(n ? n : 1);
+	if(e->data == NULL){
+		free(e);
+		return;
+	}
+	memcpy(e->data, data, n);
+	e->key = *k;
+	e->n = n;
+	e->chain = *bucket_of(c, k);
+	*bucket_of(c, k) = e;
+	push_front(c, e);
+	c->count++;
+	c->bytes += n;
+}
+
+static void disk_name(const RESULT_CACHE *c, const RESULT_KEY *k, char *name)
+{
+	sprintf(name, "%s/%016llx%016llx", c->dir, k->a, k->b);
+}
+
+int result_cache_get(RESULT_CACHE *c, const RESULT_KEY *k, void *data, size_t n)
+{
+	RESULT_ENTRY *e = find(c, k);
+	char name[300], magic[4];
+	unsigned long long len;
+	FILE *f;
+	int ok;
+
+	c->lookups++;
+	if(e != NULL && e->n == n){
+		unlink_entry(c, e);
+		push_front(c, e);
+		memcpy(data, e->data, n);
+		c->memory_hits++;
+		c->bytes_saved += n;
+		return 1;
+	}
+	if(!c->dir[0])
+		return 0;
+	disk_name(c, k, name);
+	f = fopen(name, "rb");
+	if(f == NULL)
+		return 0;
+	ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, RESULT_MAGIC, 4) == 0
+		&& fread(&len, sizeof(len), 1, f) == 1 && len == n && fread(data, 1, n, f) == n;
+	fclose(f);
+	if(!ok)
+		return 0;
+	remember(c, k, data, n);
+	c->disk_hits++;
+	c->bytes_saved += n;
+	return 1;
+}
+
+void result_cache_put(RESULT_CACHE *c, const RESULT_KEY *k, const void *data, size_t n)
+{
+	char name[300], tmp[320];
+	unsigned long long len = n;
+	FILE *f;
+
+	c->stores++;
+	remember(c, k, data, n);
+	if(!c->dir[0])
+		return;
+	/* whole files only, other processes may be reading the directory */
+	disk_name(c, k, name);
+	sprintf(tmp, "%s.%d", name, (int)getpid());
+	f = fopen(tmp, "wb");
+	if(f == NULL)
+		return;
+	fwrite(RESULT_MAGIC, 1, 4, f);
+	fwrite(&len, sizeof(len), 1, f);
+	fwrite(data, 1, n, f);
+	if(fclose(f) != 0 || rename(tmp, name) != 0)
+		remove(tmp);
+}
+
+static size_t image_bytes(const IMAGE *img, int planes)
+{
+	size_t n = 0;
+	int p;
+	for(p=0;p<NUM_PLANES;p++)
+		if(planes & (1<<p))
+			n += (size_t)img->H*img->W;
+	return n;
+}
+
+int result_cache_get_image(RESULT_CACHE *c, const RESULT_KEY *k, IMAGE *img, int planes)
+{
+	size_t n = image_bytes(img, planes), plane = (size_t)img->H*img->W, o = 0;
+	unsigned char *buf = (unsigned char *)malloc(n ? n : 1);
+	int p, hit;
+
+	if(buf == NULL)
+		return 0;
+	hit = result_cache_get(c, k, buf, n);
+	if(hit)
+		for(p=0;p<NUM_PLANES;p++)
+			if(planes & (1<<p)){
+				memcpy(img->plane[p], buf + o, plane);
+				o += plane;
+			}
+	free(buf);
+	return hit;
+}
+
+void result_cache_put_image(RESULT_CACHE *c, const RESULT_KEY *k, const IMAGE *img, int planes)
+{
+	size_t n = image_bytes(img, planes), plane = (size_t)img->H*img->W, o = 0;
+	unsigned char *buf = (unsigned char *)malloc(n ? n : 1);
+	int p;
+
+	if(buf == NULL)
+		return;
+	for(p=0;p<NUM_PLANES;p++)
+		if(planes & (1<<p)){
+			memcpy(buf + o, img->plane[p], plane);
+			o += plane;
+		}
+	result_cache_put(c, k, buf, n);
+	free(buf);
+}
+
+void result_cache_stats(const RESULT_CACHE *c, FILE *f)
+{
+	long hits = c->memory_hits + c->disk_hits;
+	fprintf(f, "cache: %ld of %ld lookups hit (%.1f%%), %ld in memory and %ld on disk, %llu bytes served\n",
+		hits, c->lookups, c->lookups ? 100.0 * hits / c->lookups : 0.0, c->memory_hits, c->disk_hits,
+		c->bytes_saved);
+	fprintf(f, "cache: %ld results stored, %lu bytes in memory, %ld evicted\n",
+		c->stores, (unsigned long)c->bytes, c->evictions);
+}
@@ -0,0 +1,72 @@
+/* Results of filter and matrix jobs kept under a hash of their input and
+ * settings, so a frame or job seen before is not computed again. The key
+ * is 128 bits of a fast hash. The memory tier finds a key through a hash
+ * table and drops the least recently used results beyond its budget, the
+ * optional disk tier keeps one file per key in a directory, shared by the
+ * CPU and FPGA tools and the daemon. A low-pass key names what produced it, so the result of one
+ * backend is never served for another.
+ */
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "image.h"
+
+#define RESULT_CACHE_MEM (64UL<<20)	/* bytes of the memory tier */
+
+/* what a key is of, the first setting of every key */
+#define RESULT_LOWPASS 1	/* params: the clipped roi x, y, w, h, result_producer */
+#define RESULT_BILATERAL 2	/* params: radius, range sigma x 1000 */
+#define RESULT_MORPH 3		/* params: operation, kw, kh */
+#define RESULT_MATRIX 4		/* 16 x 16 product, no params */
+
+typedef struct RESULT_KEY{
+	unsigned long long a, b;
+}RESULT_KEY;
+
+typedef struct RESULT_ENTRY{
+	RESULT_KEY key;
+	unsigned char *data;
+	size_t n;
+	struct RESULT_ENTRY *prev, *next;	/* LRU order */
+	struct RESULT_ENTRY *chain;		/* next in the same bucket */
+}RESULT_ENTRY;
+
+typedef struct RESULT_CACHE{
+	size_t max_bytes, bytes;
+	char dir[256];			/* disk tier, "" for none */
+	RESULT_ENTRY *head, *tail;	/* most recently used first */
+	RESULT_ENTRY **bucket;		/* index on key.a, a power of two of them */
+	size_t nbuckets, count;
+
+	/* statistics */
+	long lookups, memory_hits, disk_hits, stores, evictions;
+	unsigned long long bytes_saved;	/* result bytes served from the cache */
+}RESULT_CACHE;
+
+/* dir NULL or "-" for no disk tier, it is made if needed */
+void result_cache_init(RESULT_CACHE *c, size_t max_bytes, const char *dir);
+void result_cache_free(RESULT_CACHE *c);
+void result_cache_stats(const RESULT_CACHE *c, FILE *f);
+
+/* a key starts from its kind and settings, then takes its input buffers
+ * in order */
+void result_key_init(RESULT_KEY *k, int kind, const int *params, int nparams);
+void result_key_add(RESULT_KEY *k, const void *data, size_t n);
+/* setting for the backend name that computes a result, 0 for NULL, the
+ * CPU */
+int result_producer(const char *name);
+
+/* 1 with the n bytes stored under k copied to data, else 0 */
+int result_cache_get(RESULT_CACHE *c, const RESULT_KEY *k, void *data, size_t n);
+void result_cache_put(RESULT_CACHE *c, const RESULT_KEY *k, const void *data, size_t n);
+
+/* the same for the planes in mask of an image, the others are not part of
+ * the key and not touched */
+void result_key_image(RESULT_KEY *k, const IMAGE *img, int planes);
+int result_cache_get_image(RESULT_CACHE *c, const RESULT_KEY *k, IMAGE *img, int planes);
+void result_cache_put_image(RESULT_CACHE *c, const RESULT_KEY *k, const IMAGE *img, int planes);
+
+#endif
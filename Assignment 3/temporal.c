@@ -0,0 +1,178 @@
+#include <string.h>
+#include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "temporal.h"
+
+int temporal_init(TEMPORAL *t, int H, int W, int N)
+{
+	int k;
+	memset(t, 0, sizeof(*t));
+	if(N < 1 || N > MAX_TEMPORAL_FRAMES)
+		return 0;
+	t->H = H;
+	t->W = W;
+	t->N = N;
+	t->ring = (IMAGE *)calloc(N, sizeof(IMAGE));
+	if(t->ring==NULL)
+		return 0;
+	for(k=0;k<N;k++)
+		if(!image_alloc(&t->ring[k],H,W)){
+			temporal_free(t);
+			return 0;
+		}
+	for(k=0;k<NUM_PLANES;k++){
+		t->sum[k] = (unsigned short *)calloc((size_t)H * W, sizeof(unsigned short));
+		if(t->sum[k]==NULL){
+			temporal_free(t);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void temporal_free(TEMPORAL *t)
+{
+	int k;
+	if(t->ring!=NULL)
+		for(k=0;k<t->N;k++)
+			image_free(&t->ring[k]);
+	free(t->ring);
+	t->ring = NULL;
+	for(k=0;k<NUM_PLANES;k++){
+		free(t->sum[k]);
+		t->sum[k] = NULL;
+	}
+}
+
+/* sum += in - old and the slot of old takes in. When the window is not
+ * full yet the slot holds nothing that was ever added. */
+static void update_row(unsigned short *sum, const unsigned char *in, unsigned char *slot, int full, int W)
+{
+	int j = 0;
+#ifdef __SSE2__
+	const __m128i z = _mm_setzero_si128();
+	for(;j+16<=W;j+=16){
+		__m128i a = _mm_loadu_si128((const __m128i *)(in+j));
+		__m128i o = full ? _mm_loadu_si128((const __m128i *)(slot+j)) : z;
+		__m128i lo = _mm_loadu_si128((const __m128i *)(sum+j));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(sum+j+8));
+		lo = _mm_sub_epi16(_mm_add_epi16(lo, _mm_unpacklo_epi8(a,z)), _mm_unpacklo_epi8(o,z));
+		hi = _mm_sub_epi16(_mm_add_epi16(hi, _mm_unpackhi_epi8(a,z)), _mm_unpackhi_epi8(o,z));
+		_mm_storeu_si128((__m128i *)(sum+j), lo);
+		_mm_storeu_si128((__m128i *)(sum+j+8), hi);
+		_mm_storeu_si128((__m128i *)(slot+j), a);
+	}
+#endif
+	for(;j<W;j++){
+		sum[j] = (unsigned short)(sum[j] + in[j] - (full ? slot[j] : 0));
+		slot[j] = in[j];
+	}
+}
+
+/* floor(s / n) computed as (s + 1/4) * (1/n) in float. Neighbouring
+ * quotients are at least 1/n apart, far more than the rounding error. */
+#ifdef __SSE2__
+static __m128i divide8(__m128i s_lo, __m128i s_hi, __m128 rc)
+{
+	const __m128 q = _mm_set1_ps(0.25f);
+	__m128i a = _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(s_lo), q), rc));
+	__m128i b = _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(s_hi), q), rc));
+	return _mm_packs_epi32(a, b);
+}
+#endif
+
+static void mean_row(const unsigned short *sum, unsigned char *d, int j0, int j1, float rc)
+{
+	int j = j0;
+#ifdef __SSE2__
+	const __m128i z = _mm_setzero_si128();
+	const __m128 r = _mm_set1_ps(rc);
+	for(;j+8<=j1;j+=8){
+		__m128i s = _mm_loadu_si128((const __m128i *)(sum+j));
+		__m128i v = divide8(_mm_unpacklo_epi16(s,z), _mm_unpackhi_epi16(s,z), r);
+		_mm_storel_epi64((__m128i *)(d+j), _mm_packus_epi16(v,z));
+	}
+#endif
+	for(;j<j1;j++)
+		d[j] = (unsigned char)((sum[j] + 0.25f) * rc);
+}
+
+/* 3x3 sum of the running sums, inner columns 1 <= j0 .. j1 <= W-1 */
+static void box_row(const unsigned short *up, const unsigned short *mid, const unsigned short *dn,
+		unsigned char *d, int j0, int j1, float rc)
+{
+	int j = j0, o;
+#ifdef __SSE2__
+	const __m128i z = _mm_setzero_si128();
+	const __m128 r = _mm_set1_ps(rc);
+	for(;j+8<=j1;j+=8){
+		__m128i lo = z, hi = z, v;
+		for(o=-1;o<=1;o++){
+			__m128i a = _mm_loadu_si128((const __m128i *)(up+j+o));
+			__m128i b = _mm_loadu_si128((const __m128i *)(mid+j+o));
+			__m128i c = _mm_loadu_si128((const __m128i *)(dn+j+o));
+			lo = _mm_add_epi32(lo, _mm_add_epi32(_mm_unpacklo_epi16(a,z),
+						_mm_add_epi32(_mm_unpacklo_epi16(b,z), _mm_unpacklo_epi16(c,z))));
+			hi = _mm_add_epi32(hi, _mm_add_epi32(_mm_unpackhi_epi16(a,z),
+						_mm_add_epi32(_mm_unpackhi_epi16(b,z), _mm_unpackhi_epi16(c,z))));
+		}
+		v = divide8(lo, hi, r);
+		_mm_storel_epi64((__m128i *)(d+j), _mm_packus_epi16(v,z));
+	}
+#endif
+	for(;j<j1;j++){
+		unsigned int s = 0;
+		for(o=-1;o<=1;o++)
+			s += up[j+o] + mid[j+o] + dn[j+o];
+		d[j] = (unsigned char)((s + 0.25f) * rc);
+	}
+}
+
+void temporal_lowpass(TEMPORAL *t, const IMAGE *frame, IMAGE *out, int spatial)
+{
+	IMAGE *slot = &t->ring[t->head];
+	int full = t->count == t->N;
+	int H = t->H, W = t->W;
+	float rc, rc9;
+	int k, i;
+
+	if(!full)
+		t->count++;
+	rc = 1.0f / t->count;
+	rc9 = 1.0f / (9 * t->count);
+
+	/* both loops split rows over the same threads, the implicit barrier
+	 * after the first makes the halo rows of the sums ready for the second */
+	#pragma omp parallel private(k)
+	{
+		for(k=0;k<NUM_PLANES;k++){
+			if(frame->plane[k]==NULL)
+				continue;
+			#pragma omp for schedule(static)
+			for(i=0;i<H;i++){
+				size_t o = (size_t)i * W;
+				update_row(t->sum[k] + o, frame->plane[k] + o, slot->plane[k] + o, full, W);
+			}
+		}
+		for(k=0;k<NUM_PLANES;k++){
+			if(frame->plane[k]==NULL)
+				continue;
+			#pragma omp for schedule(static)
+			for(i=0;i<H;i++){
+				const unsigned short *s = t->sum[k] + (size_t)i * W;
+				unsigned char *d = out->plane[k] + (size_t)i * W;
+				if(!spatial || i==0 || i==H-1 || W<3){
+					mean_row(s, d, 0, W, rc);
+					continue;
+				}
+				mean_row(s, d, 0, 1, rc);
+				box_row(s - W, s, s + W, d, 1, W-1, rc9);
+				mean_row(s, d, W-1, W, rc);
+			}
+		}
+	}
+	t->head = (t->head + 1) % t->N;
+}
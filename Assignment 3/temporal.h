@@ -0,0 +1,34 @@
+/* Temporal low-pass for static cameras: every output pixel is the mean of
+ * the same pixel over the last N frames. The frames live in a circular
+ * buffer and a 16-bit running sum per pixel is updated with the entering
+ * and the leaving frame, so the cost per frame does not depend on N.
+ * Only the mean is offered, a running median has no such O(1) update.
+ */
+
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include "image.h"
+
+/* 255 * N must fit the 16-bit running sums */
+#define MAX_TEMPORAL_FRAMES 257
+
+typedef struct TEMPORAL{
+	int H, W;
+	int N;                          /* window length in frames */
+	int count;                      /* frames in the window so far, <= N */
+	int head;                       /* slot the next frame goes to */
+	IMAGE *ring;                    /* the last N input frames */
+	unsigned short *sum[NUM_PLANES];/* running sum per pixel */
+}TEMPORAL;
+
+int temporal_init(TEMPORAL *t, int H, int W, int N);
+void temporal_free(TEMPORAL *t);
+
+/* push frame into the window and write the truncated temporal mean to out.
+ * With spatial set the inner pixels get the mean over the 3x3 neighbourhood
+ * of all frames in the window instead, computed from the running sums in
+ * the same pass; border pixels keep the temporal mean as in box_filter.h. */
+void temporal_lowpass(TEMPORAL *t, const IMAGE *frame, IMAGE *out, int spatial);
+
+#endif
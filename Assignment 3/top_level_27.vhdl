@@ -371,6 +371,10 @@ END COMPONENT;
 	signal wea33                     : std_logic_vector(0 downto 0)  :="0";
 	signal dina33			 : std_logic_vector(7 downto 0)  := x"00";
 	signal douta33					 : std_logic_vector(7 downto 0)  := x"00";
+	-- The filter writes the window row by row into RAM 31-33, one per
+	-- colour: the border as it is, inside it the 12-bit sum of the nine
+	-- neighbours divided by 9. The host selects channel 0 to rewind them
+	-- and reads channels 0x31-0x33, the first byte stale.
 	
 	signal dividend   :std_logic_vector(11 downto 0)  := "000000000000";
 	signal divisor   :std_logic_vector(7 downto 0)  := "00000000";
@@ -379,6 +383,86 @@ END COMPONENT;
 	signal sclr :std_logic :='0';
 	signal quotient   :std_logic_vector(11 downto 0)  := "000000000000";
 	signal fractional   :std_logic_vector(7 downto 0)  := "00000000";
+
+	-- Ping-pong banks: once channel 14 is written with bit 1 clear, bit 12
+	-- of every phase address picks one of two 4096-byte banks. The host
+	-- sees bank, the filter works on the other one while it runs. Writing it with bit 1 set goes back to whole BRAMs.
+	signal bank   :std_logic :='0';
+	signal banked :std_logic :='0';
+
+	-- Window the filter runs over, set by channels 11 and 12 as its last
+	-- column and row, 256 x 256 until then.
+	signal lastCol :integer range 0 to 255 := 255;
+	signal lastRow :integer range 0 to 255 := 255;
+
+	-- The filter starts when channel 16 is selected and takes a pixel a
+	-- clock: it puts the addresses of pixel (fI, fJ) on port b, a clock
+	-- later the BRAMs have its neighbours on doutb and the result goes to
+	-- RAM 31-33. fEdge and fSel tell a border pixel and its BRAM along.
+	-- While it is busy the host waits on the channels that would disturb it.
+	signal fRun    :std_logic :='0';
+	signal fSeen   :std_logic :='0';		-- channel 16 has started it
+	signal fI      :integer range 0 to 255 := 0;
+	signal fJ      :integer range 0 to 255 := 0;
+	signal fFeed   :std_logic :='0';		-- addresses on port b
+	signal fData   :std_logic :='0';		-- their data on doutb
+	signal fEdgeA, fEdgeB :std_logic :='0';
+	signal fSelA, fSelB   :integer range 1 to 9 := 1;
+	signal fBusy   :std_logic;
+	signal fHold   :std_logic;
+	signal fBorder31, fBorder32, fBorder33 :std_logic_vector(7 downto 0);
+	signal fSum31, fSum32, fSum33 :unsigned(11 downto 0);
+
+	-- Address in the phase BRAM of row phase pr and column phase pc of the
+	-- neighbour of pixel (i, j) with those phases. The BRAM keeps its rows
+	-- one after the other, (lastCol + 3 - pc)/3 bytes each. On the border
+	-- only the pixel's own BRAM is used, the others may point anywhere.
+	function phaseAddr(i, j, pr, pc, lastCol : integer) return std_logic_vector is
+		variable r, c : integer;
+	begin
+		r := i - 1 + (pr - i + 1) mod 3;
+		c := j - 1 + (pc - j + 1) mod 3;
+		if(r < 0) then
+			r := r + 3;
+		end if;
+		if(c < 0) then
+			c := c + 3;
+		end if;
+		return std_logic_vector(to_unsigned((r/3)*((lastCol + 3 - pc)/3) + c/3, 13));
+	end function;
+
+	-- phase BRAM channels 1-9, 0x11-0x19 and 0x21-0x29
+	function isPhase(chan : std_logic_vector(6 downto 0)) return boolean is
+	begin
+		return unsigned(chan(6 downto 4)) < 3 and unsigned(chan(3 downto 0)) >= 1
+			and unsigned(chan(3 downto 0)) <= 9;
+	end function;
+
+	-- Compressed uploads, see deltarle.h. Once bit 0 of channel 13 is set,
+	-- writes to the phase channels go through a decoder that rebuilds the
+	-- bytes from differences and runs. It restarts whenever another
+	-- channel is selected and holds the host off while a run is written.
+	-- comm_fpga_fx2 reads the channel of the next command without looking
+	-- at h2fReady, so a coded stream must not end in a run, see deltarle.h.
+	constant Z_CTRL    :std_logic_vector(1 downto 0) :="00";
+	constant Z_LIT     :std_logic_vector(1 downto 0) :="01";
+	constant Z_RUN     :std_logic_vector(1 downto 0) :="10";
+	constant Z_REPEAT  :std_logic_vector(1 downto 0) :="11";
+	signal zMode     :std_logic :='0';
+	signal zState    :std_logic_vector(1 downto 0) :=Z_CTRL;
+	signal zCount    :std_logic_vector(6 downto 0) :="0000000";
+	signal zDelta    :std_logic_vector(7 downto 0) :=x"00";
+	signal zPrev     :std_logic_vector(7 downto 0) :=x"00";
+	signal zChan     :std_logic_vector(6 downto 0) :="0000000";
+	signal zValid    :std_logic;
+	signal zData     :std_logic_vector(7 downto 0);
+	signal wrValid   :std_logic;			-- a byte for the phase BRAMs
+	signal wrData    :std_logic_vector(7 downto 0);
+
+	-- Design identity, read from channel 127 as the four bytes "LP27". The
+	-- host checks it and skips loading the bitstream when it matches.
+	signal idIndex :std_logic_vector(1 downto 0) :="00";
+	signal idByte  :std_logic_vector(7 downto 0);
 begin													-- BEGIN_SNIPPET(registers)
 	
 	------------- Begin Cut here for INSTANTIATION Template ----- INST_TAG
@@ -854,7 +938,7 @@ bram33 : calculated
 	--For color Blue
 	
 	-----------increment addra when channel 1 write------------------
-			if(chanAddr = "0000001" and h2fValid = '1') then
+			if(chanAddr = "0000001" and wrValid = '1') then
 				addra1 <= addra1 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 1 read-------------------		
@@ -867,7 +951,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 2 write------------------
-			if(chanAddr = "0000010" and h2fValid = '1') then
+			if(chanAddr = "0000010" and wrValid = '1') then
 				addra2 <= addra2 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 2 read-------------------		
@@ -880,7 +964,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 3 write------------------
-			if(chanAddr = "0000011" and h2fValid = '1') then
+			if(chanAddr = "0000011" and wrValid = '1') then
 				addra3 <= addra3 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 3 read-------------------		
@@ -893,7 +977,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 4 write------------------
-			if(chanAddr = "0000100" and h2fValid = '1') then
+			if(chanAddr = "0000100" and wrValid = '1') then
 				addra4 <= addra4 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 4 read-------------------		
@@ -906,7 +990,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 5 write------------------
-			if(chanAddr = "0000101" and h2fValid = '1') then
+			if(chanAddr = "0000101" and wrValid = '1') then
 				addra5 <= addra5 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 5 read-------------------		
@@ -919,7 +1003,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 6 write------------------
-			if(chanAddr = "0000110" and h2fValid = '1') then
+			if(chanAddr = "0000110" and wrValid = '1') then
 				addra6 <= addra6 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 6 read-------------------		
@@ -932,7 +1016,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 7 write------------------
-			if(chanAddr = "0000111" and h2fValid = '1') then
+			if(chanAddr = "0000111" and wrValid = '1') then
 				addra7 <= addra7 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 7 read-------------------		
@@ -945,7 +1029,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 8 write------------------
-			if(chanAddr = "0001000" and h2fValid = '1') then
+			if(chanAddr = "0001000" and wrValid = '1') then
 				addra8 <= addra8 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 8 read-------------------		
@@ -958,7 +1042,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 9 write------------------
-			if(chanAddr = "0001001" and h2fValid = '1') then
+			if(chanAddr = "0001001" and wrValid = '1') then
 				addra9 <= addra9 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 9 read-------------------		
@@ -975,7 +1059,7 @@ bram33 : calculated
 	
 		
 	-----------increment addra when channel 11 write------------------
-			if(chanAddr = "0010001" and h2fValid = '1') then
+			if(chanAddr = "0010001" and wrValid = '1') then
 				addra11 <= addra11 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 1 read-------------------		
@@ -988,7 +1072,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 12 write------------------
-			if(chanAddr = "0010010" and h2fValid = '1') then
+			if(chanAddr = "0010010" and wrValid = '1') then
 				addra12 <= addra12 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 12 read-------------------		
@@ -1001,7 +1085,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 13 write------------------
-			if(chanAddr = "0010011" and h2fValid = '1') then
+			if(chanAddr = "0010011" and wrValid = '1') then
 				addra13 <= addra13 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 13 read-------------------		
@@ -1014,7 +1098,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 14 write------------------
-			if(chanAddr = "0010100" and h2fValid = '1') then
+			if(chanAddr = "0010100" and wrValid = '1') then
 				addra14 <= addra14 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 14 read-------------------		
@@ -1027,7 +1111,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 15 write------------------
-			if(chanAddr = "0010101" and h2fValid = '1') then
+			if(chanAddr = "0010101" and wrValid = '1') then
 				addra15 <= addra15 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 15 read-------------------		
@@ -1040,7 +1124,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 16 write------------------
-			if(chanAddr = "0010110" and h2fValid = '1') then
+			if(chanAddr = "0010110" and wrValid = '1') then
 				addra16 <= addra16 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 16 read-------------------		
@@ -1053,7 +1137,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 17 write------------------
-			if(chanAddr = "0010111" and h2fValid = '1') then
+			if(chanAddr = "0010111" and wrValid = '1') then
 				addra17 <= addra17 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 17 read-------------------		
@@ -1066,7 +1150,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 18 write------------------
-			if(chanAddr = "0011000" and h2fValid = '1') then
+			if(chanAddr = "0011000" and wrValid = '1') then
 				addra18 <= addra18 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 18 read-------------------		
@@ -1079,7 +1163,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 19 write------------------
-			if(chanAddr = "0011001" and h2fValid = '1') then
+			if(chanAddr = "0011001" and wrValid = '1') then
 				addra19 <= addra19 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 19 read-------------------		
@@ -1093,7 +1177,7 @@ bram33 : calculated
 	
 		
 	-----------increment addra when channel 21 write------------------
-			if(chanAddr = "0100001" and h2fValid = '1') then
+			if(chanAddr = "0100001" and wrValid = '1') then
 				addra21 <= addra21 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 21 read-------------------		
@@ -1106,7 +1190,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 22 write------------------
-			if(chanAddr = "0100010" and h2fValid = '1') then
+			if(chanAddr = "0100010" and wrValid = '1') then
 				addra22 <= addra22 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 22 read-------------------		
@@ -1119,7 +1203,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 23 write------------------
-			if(chanAddr = "0100011" and h2fValid = '1') then
+			if(chanAddr = "0100011" and wrValid = '1') then
 				addra23 <= addra23 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 23 read-------------------		
@@ -1132,7 +1216,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 24 write------------------
-			if(chanAddr = "0100100" and h2fValid = '1') then
+			if(chanAddr = "0100100" and wrValid = '1') then
 				addra24 <= addra24 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 24 read-------------------		
@@ -1145,7 +1229,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 25 write------------------
-			if(chanAddr = "0100101" and h2fValid = '1') then
+			if(chanAddr = "0100101" and wrValid = '1') then
 				addra25 <= addra25 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 25 read-------------------		
@@ -1158,7 +1242,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 26 write------------------
-			if(chanAddr = "0100110" and h2fValid = '1') then
+			if(chanAddr = "0100110" and wrValid = '1') then
 				addra26 <= addra26 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 26 read-------------------		
@@ -1171,7 +1255,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 27 write------------------
-			if(chanAddr = "0100111" and h2fValid = '1') then
+			if(chanAddr = "0100111" and wrValid = '1') then
 				addra27 <= addra27 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 27 read-------------------		
@@ -1184,7 +1268,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 28 write------------------
-			if(chanAddr = "0101000" and h2fValid = '1') then
+			if(chanAddr = "0101000" and wrValid = '1') then
 				addra28 <= addra28 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 28 read-------------------		
@@ -1197,7 +1281,7 @@ bram33 : calculated
 			end if;
 	
 	-----------increment addra when channel 29 write------------------
-			if(chanAddr = "0101001" and h2fValid = '1') then
+			if(chanAddr = "0101001" and wrValid = '1') then
 				addra29 <= addra29 + "0000000000001";
 			end if;
 	-----------increment addrb when channel 29 read-------------------		
@@ -1208,343 +1292,456 @@ bram33 : calculated
 			if(chanAddr = "0000000") then
 				addrb29 <= "0000000000000";
 			end if;
+	-----------output BRAMs: the filter writes them, else increment on read-----
+	-----------and rewind when channel 0 active--------------------------------
+			if(fData = '1') then
+				addra31 <= addra31 + "0000000000000001";
+				addra32 <= addra32 + "0000000000000001";
+				addra33 <= addra33 + "0000000000000001";
+			elsif(fBusy = '0') then
+				if(chanAddr = "0110001" and f2hReady='1') then
+					addra31 <= addra31 + "0000000000000001";
+				end if;
+				if(chanAddr = "0110010" and f2hReady='1') then
+					addra32 <= addra32 + "0000000000000001";
+				end if;
+				if(chanAddr = "0110011" and f2hReady='1') then
+					addra33 <= addra33 + "0000000000000001";
+				end if;
+				if(chanAddr = "0000000") then
+					addra31 <= "0000000000000000";
+					addra32 <= "0000000000000000";
+					addra33 <= "0000000000000000";
+				end if;
+			end if;
+	-----------channel 11 and 12 write: last column and row of the window--------
+			if(chanAddr = "0001011" and h2fValid = '1') then
+				lastCol <= to_integer(unsigned(h2fData));
+			end if;
+			if(chanAddr = "0001100" and h2fValid = '1') then
+				lastRow <= to_integer(unsigned(h2fData));
+			end if;
+	-----------channel 13 write: bit 0 turns the upload decoder on---------------
+			if(chanAddr = "0001101" and h2fValid = '1') then
+				zMode <= h2fData(0);
+			end if;
+	-----------upload decoder, one state per byte in or, in a run, out-----------
+			if(chanAddr /= zChan) then
+				zChan <= chanAddr;
+				zState <= Z_CTRL;
+				zPrev <= x"00";
+			elsif(zMode = '1') then
+				case zState is
+					when Z_CTRL =>
+						if(h2fValid = '1') then
+							zCount <= h2fData(6 downto 0);
+							if(h2fData(7) = '0') then
+								zState <= Z_LIT;
+							else
+								zState <= Z_RUN;
+							end if;
+						end if;
+					when Z_LIT =>
+						if(h2fValid = '1') then
+							zPrev <= zData;
+							if(zCount = "0000000") then
+								zState <= Z_CTRL;
+							else
+								zCount <= zCount - "0000001";
+							end if;
+						end if;
+					when Z_RUN =>
+						if(h2fValid = '1') then
+							zPrev <= zData;
+							zDelta <= h2fData;
+							zState <= Z_REPEAT;
+						end if;
+					when others =>
+						zPrev <= zData;
+						if(zCount = "0000000") then
+							zState <= Z_CTRL;
+						else
+							zCount <= zCount - "0000001";
+						end if;
+				end case;
+			end if;
+	-----------channel 14 write: bit 0 is the host bank, bit 1 unbanks, rewind all addresses
+			if(chanAddr = "0001110" and h2fValid = '1') then
+				bank <= h2fData(0);
+				banked <= not h2fData(1);
+				addra1 <= "0000000000000";
+				addrb1 <= "0000000000000";
+				addra2 <= "0000000000000";
+				addrb2 <= "0000000000000";
+				addra3 <= "0000000000000";
+				addrb3 <= "0000000000000";
+				addra4 <= "0000000000000";
+				addrb4 <= "0000000000000";
+				addra5 <= "0000000000000";
+				addrb5 <= "0000000000000";
+				addra6 <= "0000000000000";
+				addrb6 <= "0000000000000";
+				addra7 <= "0000000000000";
+				addrb7 <= "0000000000000";
+				addra8 <= "0000000000000";
+				addrb8 <= "0000000000000";
+				addra9 <= "0000000000000";
+				addrb9 <= "0000000000000";
+				addra11 <= "0000000000000";
+				addrb11 <= "0000000000000";
+				addra12 <= "0000000000000";
+				addrb12 <= "0000000000000";
+				addra13 <= "0000000000000";
+				addrb13 <= "0000000000000";
+				addra14 <= "0000000000000";
+				addrb14 <= "0000000000000";
+				addra15 <= "0000000000000";
+				addrb15 <= "0000000000000";
+				addra16 <= "0000000000000";
+				addrb16 <= "0000000000000";
+				addra17 <= "0000000000000";
+				addrb17 <= "0000000000000";
+				addra18 <= "0000000000000";
+				addrb18 <= "0000000000000";
+				addra19 <= "0000000000000";
+				addrb19 <= "0000000000000";
+				addra21 <= "0000000000000";
+				addrb21 <= "0000000000000";
+				addra22 <= "0000000000000";
+				addrb22 <= "0000000000000";
+				addra23 <= "0000000000000";
+				addrb23 <= "0000000000000";
+				addra24 <= "0000000000000";
+				addrb24 <= "0000000000000";
+				addra25 <= "0000000000000";
+				addrb25 <= "0000000000000";
+				addra26 <= "0000000000000";
+				addrb26 <= "0000000000000";
+				addra27 <= "0000000000000";
+				addrb27 <= "0000000000000";
+				addra28 <= "0000000000000";
+				addrb28 <= "0000000000000";
+				addra29 <= "0000000000000";
+				addrb29 <= "0000000000000";
+			end if;
+	-----------next identity byte per read, from the first when selected again---
+			if(chanAddr = "1111111" and f2hReady = '1') then
+				idIndex <= idIndex + "01";
+			elsif(chanAddr /= "1111111") then
+				idIndex <= "00";
+			end if;
+	-----------filter: start on channel 16, then a pixel a clock-----------------
+			if(chanAddr /= "0010000") then
+				fSeen <= '0';
+			elsif(fSeen = '0' and fBusy = '0') then
+				fSeen <= '1';
+				fRun <= '1';
+				fI <= 0;
+				fJ <= 0;
+			end if;
+			fFeed <= fRun;
+			fData <= fFeed;
+			fEdgeB <= fEdgeA;
+			fSelB <= fSelA;
+			if(fRun = '1') then
+				if(fI = 0 or fI = lastRow or fJ = 0 or fJ = lastCol) then
+					fEdgeA <= '1';
+				else
+					fEdgeA <= '0';
+				end if;
+				fSelA <= 1 + fI mod 3 + 3*(fJ mod 3);
+				addrb1 <= phaseAddr(fI, fJ, 0, 0, lastCol);
+				addrb11 <= phaseAddr(fI, fJ, 0, 0, lastCol);
+				addrb21 <= phaseAddr(fI, fJ, 0, 0, lastCol);
+				addrb2 <= phaseAddr(fI, fJ, 1, 0, lastCol);
+				addrb12 <= phaseAddr(fI, fJ, 1, 0, lastCol);
+				addrb22 <= phaseAddr(fI, fJ, 1, 0, lastCol);
+				addrb3 <= phaseAddr(fI, fJ, 2, 0, lastCol);
+				addrb13 <= phaseAddr(fI, fJ, 2, 0, lastCol);
+				addrb23 <= phaseAddr(fI, fJ, 2, 0, lastCol);
+				addrb4 <= phaseAddr(fI, fJ, 0, 1, lastCol);
+				addrb14 <= phaseAddr(fI, fJ, 0, 1, lastCol);
+				addrb24 <= phaseAddr(fI, fJ, 0, 1, lastCol);
+				addrb5 <= phaseAddr(fI, fJ, 1, 1, lastCol);
+				addrb15 <= phaseAddr(fI, fJ, 1, 1, lastCol);
+				addrb25 <= phaseAddr(fI, fJ, 1, 1, lastCol);
+				addrb6 <= phaseAddr(fI, fJ, 2, 1, lastCol);
+				addrb16 <= phaseAddr(fI, fJ, 2, 1, lastCol);
+				addrb26 <= phaseAddr(fI, fJ, 2, 1, lastCol);
+				addrb7 <= phaseAddr(fI, fJ, 0, 2, lastCol);
+				addrb17 <= phaseAddr(fI, fJ, 0, 2, lastCol);
+				addrb27 <= phaseAddr(fI, fJ, 0, 2, lastCol);
+				addrb8 <= phaseAddr(fI, fJ, 1, 2, lastCol);
+				addrb18 <= phaseAddr(fI, fJ, 1, 2, lastCol);
+				addrb28 <= phaseAddr(fI, fJ, 1, 2, lastCol);
+				addrb9 <= phaseAddr(fI, fJ, 2, 2, lastCol);
+				addrb19 <= phaseAddr(fI, fJ, 2, 2, lastCol);
+				addrb29 <= phaseAddr(fI, fJ, 2, 2, lastCol);
+				if(fJ < lastCol) then
+					fJ <= fJ + 1;
+				else
+					fJ <= 0;
+					if(fI < lastRow) then
+						fI <= fI + 1;
+					else
+						fRun <= '0';
+					end if;
+				end if;
+			end if;
+	-----------bit 12 selects the bank, port b of the filter uses the other one---
+			if(banked = '1') then
+				addra1(12) <= bank;
+				addra2(12) <= bank;
+				addra3(12) <= bank;
+				addra4(12) <= bank;
+				addra5(12) <= bank;
+				addra6(12) <= bank;
+				addra7(12) <= bank;
+				addra8(12) <= bank;
+				addra9(12) <= bank;
+				addra11(12) <= bank;
+				addra12(12) <= bank;
+				addra13(12) <= bank;
+				addra14(12) <= bank;
+				addra15(12) <= bank;
+				addra16(12) <= bank;
+				addra17(12) <= bank;
+				addra18(12) <= bank;
+				addra19(12) <= bank;
+				addra21(12) <= bank;
+				addra22(12) <= bank;
+				addra23(12) <= bank;
+				addra24(12) <= bank;
+				addra25(12) <= bank;
+				addra26(12) <= bank;
+				addra27(12) <= bank;
+				addra28(12) <= bank;
+				addra29(12) <= bank;
+				if(fRun = '1') then
+					addrb1(12) <= not bank;
+					addrb2(12) <= not bank;
+					addrb3(12) <= not bank;
+					addrb4(12) <= not bank;
+					addrb5(12) <= not bank;
+					addrb6(12) <= not bank;
+					addrb7(12) <= not bank;
+					addrb8(12) <= not bank;
+					addrb9(12) <= not bank;
+					addrb11(12) <= not bank;
+					addrb12(12) <= not bank;
+					addrb13(12) <= not bank;
+					addrb14(12) <= not bank;
+					addrb15(12) <= not bank;
+					addrb16(12) <= not bank;
+					addrb17(12) <= not bank;
+					addrb18(12) <= not bank;
+					addrb19(12) <= not bank;
+					addrb21(12) <= not bank;
+					addrb22(12) <= not bank;
+					addrb23(12) <= not bank;
+					addrb24(12) <= not bank;
+					addrb25(12) <= not bank;
+					addrb26(12) <= not bank;
+					addrb27(12) <= not bank;
+					addrb28(12) <= not bank;
+					addrb29(12) <= not bank;
+				else
+					addrb1(12) <= bank;
+					addrb2(12) <= bank;
+					addrb3(12) <= bank;
+					addrb4(12) <= bank;
+					addrb5(12) <= bank;
+					addrb6(12) <= bank;
+					addrb7(12) <= bank;
+					addrb8(12) <= bank;
+					addrb9(12) <= bank;
+					addrb11(12) <= bank;
+					addrb12(12) <= bank;
+					addrb13(12) <= bank;
+					addrb14(12) <= bank;
+					addrb15(12) <= bank;
+					addrb16(12) <= bank;
+					addrb17(12) <= bank;
+					addrb18(12) <= bank;
+					addrb19(12) <= bank;
+					addrb21(12) <= bank;
+					addrb22(12) <= bank;
+					addrb23(12) <= bank;
+					addrb24(12) <= bank;
+					addrb25(12) <= bank;
+					addrb26(12) <= bank;
+					addrb27(12) <= bank;
+					addrb28(12) <= bank;
+					addrb29(12) <= bank;
+				end if;
+			end if;
 		end if;
 	end process;
 	
 	--write enable on when channels has data from host
-	wea1 <="1" when chanAddr = "0000001" and h2fValid = '1' else "0";
+	wea1 <="1" when chanAddr = "0000001" and wrValid = '1' else "0";
 	web1 <="0";
-	wea2 <="1" when chanAddr = "0000010" and h2fValid = '1' else "0";
+	wea2 <="1" when chanAddr = "0000010" and wrValid = '1' else "0";
 	web2 <="0";
-	wea3 <="1" when chanAddr = "0000011" and h2fValid = '1' else "0";
+	wea3 <="1" when chanAddr = "0000011" and wrValid = '1' else "0";
 	web3 <="0";
-	wea4 <="1" when chanAddr = "0000100" and h2fValid = '1' else "0";
+	wea4 <="1" when chanAddr = "0000100" and wrValid = '1' else "0";
 	web4 <="0";
-	wea5 <="1" when chanAddr = "0000101" and h2fValid = '1' else "0";
+	wea5 <="1" when chanAddr = "0000101" and wrValid = '1' else "0";
 	web5 <="0";
-	wea6 <="1" when chanAddr = "0000110" and h2fValid = '1' else "0";
+	wea6 <="1" when chanAddr = "0000110" and wrValid = '1' else "0";
 	web6 <="0";
-	wea7 <="1" when chanAddr = "0000111" and h2fValid = '1' else "0";
+	wea7 <="1" when chanAddr = "0000111" and wrValid = '1' else "0";
 	web7 <="0";
-	wea8 <="1" when chanAddr = "0001000" and h2fValid = '1' else "0";
+	wea8 <="1" when chanAddr = "0001000" and wrValid = '1' else "0";
 	web8 <="0";
-	wea9 <="1" when chanAddr = "0001001" and h2fValid = '1' else "0";
+	wea9 <="1" when chanAddr = "0001001" and wrValid = '1' else "0";
 	web9 <="0";
 	--write enable on when channels has data from host
-	wea11 <="1" when chanAddr = "0010001" and h2fValid = '1' else "0";
+	wea11 <="1" when chanAddr = "0010001" and wrValid = '1' else "0";
 	web11 <="0";
-	wea12 <="1" when chanAddr = "0010010" and h2fValid = '1' else "0";
+	wea12 <="1" when chanAddr = "0010010" and wrValid = '1' else "0";
 	web12 <="0";
-	wea13 <="1" when chanAddr = "0010011" and h2fValid = '1' else "0";
+	wea13 <="1" when chanAddr = "0010011" and wrValid = '1' else "0";
 	web13 <="0";
-	wea14 <="1" when chanAddr = "0010100" and h2fValid = '1' else "0";
+	wea14 <="1" when chanAddr = "0010100" and wrValid = '1' else "0";
 	web14 <="0";
-	wea15 <="1" when chanAddr = "0010101" and h2fValid = '1' else "0";
+	wea15 <="1" when chanAddr = "0010101" and wrValid = '1' else "0";
 	web15 <="0";
-	wea16 <="1" when chanAddr = "0010110" and h2fValid = '1' else "0";
+	wea16 <="1" when chanAddr = "0010110" and wrValid = '1' else "0";
 	web16 <="0";
-	wea17 <="1" when chanAddr = "0010111" and h2fValid = '1' else "0";
+	wea17 <="1" when chanAddr = "0010111" and wrValid = '1' else "0";
 	web17 <="0";
-	wea18 <="1" when chanAddr = "0011000" and h2fValid = '1' else "0";
+	wea18 <="1" when chanAddr = "0011000" and wrValid = '1' else "0";
 	web18 <="0";
-	wea19 <="1" when chanAddr = "0011001" and h2fValid = '1' else "0";
+	wea19 <="1" when chanAddr = "0011001" and wrValid = '1' else "0";
 	web19 <="0";
 	--write enable on when channels has data from host
-	wea21 <="1" when chanAddr = "0100001" and h2fValid = '1' else "0";
+	wea21 <="1" when chanAddr = "0100001" and wrValid = '1' else "0";
 	web21 <="0";
-	wea22 <="1" when chanAddr = "0100010" and h2fValid = '1' else "0";
+	wea22 <="1" when chanAddr = "0100010" and wrValid = '1' else "0";
 	web22 <="0";
-	wea23 <="1" when chanAddr = "0100011" and h2fValid = '1' else "0";
+	wea23 <="1" when chanAddr = "0100011" and wrValid = '1' else "0";
 	web23 <="0";
-	wea24 <="1" when chanAddr = "0100100" and h2fValid = '1' else "0";
+	wea24 <="1" when chanAddr = "0100100" and wrValid = '1' else "0";
 	web24 <="0";
-	wea25 <="1" when chanAddr = "0100101" and h2fValid = '1' else "0";
+	wea25 <="1" when chanAddr = "0100101" and wrValid = '1' else "0";
 	web25 <="0";
-	wea26 <="1" when chanAddr = "0100110" and h2fValid = '1' else "0";
+	wea26 <="1" when chanAddr = "0100110" and wrValid = '1' else "0";
 	web26 <="0";
-	wea27 <="1" when chanAddr = "0100111" and h2fValid = '1' else "0";
+	wea27 <="1" when chanAddr = "0100111" and wrValid = '1' else "0";
 	web27 <="0";
-	wea28 <="1" when chanAddr = "0101000" and h2fValid = '1' else "0";
+	wea28 <="1" when chanAddr = "0101000" and wrValid = '1' else "0";
 	web28 <="0";
-	wea29 <="1" when chanAddr = "0101001" and h2fValid = '1' else "0";
+	wea29 <="1" when chanAddr = "0101001" and wrValid = '1' else "0";
 	web29 <="0";
-	wea31 <="0";
-	wea32 <="0";
-	wea33 <="0";
+	-- the filter writes its result into the output BRAMs
+	wea31 <="1" when fData = '1' else "0";
+	wea32 <="1" when fData = '1' else "0";
+	wea33 <="1" when fData = '1' else "0";
 
 	-----------------data always sent to din , but written only when en=1
-	dina1 <= h2fData when chanAddr = "0000001" and h2fValid = '1' else "00000000";
+	dina1 <= wrData when chanAddr = "0000001" and wrValid = '1' else "00000000";
 	--dinb1 <= h2fData;
-	dina2 <= h2fData when chanAddr = "0000010" and h2fValid = '1' else "00000000";
+	dina2 <= wrData when chanAddr = "0000010" and wrValid = '1' else "00000000";
 	--dinb2 <= h2fData;
-	dina3 <= h2fData when chanAddr = "0000011" and h2fValid = '1' else "00000000";
+	dina3 <= wrData when chanAddr = "0000011" and wrValid = '1' else "00000000";
 	--dinb3 <= h2fData;
-	dina4 <= h2fData when chanAddr = "0000100" and h2fValid = '1' else "00000000";
+	dina4 <= wrData when chanAddr = "0000100" and wrValid = '1' else "00000000";
 	--dinb4 <= h2fData;
-	dina5 <= h2fData when chanAddr = "0000101" and h2fValid = '1' else "00000000";
+	dina5 <= wrData when chanAddr = "0000101" and wrValid = '1' else "00000000";
 	--dinb5 <= h2fData;
-	dina6 <= h2fData when chanAddr = "0000110" and h2fValid = '1' else "00000000";
+	dina6 <= wrData when chanAddr = "0000110" and wrValid = '1' else "00000000";
 	--dinb6 <= h2fData;
-	dina7 <= h2fData when chanAddr = "0000111" and h2fValid = '1' else "00000000";
+	dina7 <= wrData when chanAddr = "0000111" and wrValid = '1' else "00000000";
 	--dinb7 <= h2fData;
-	dina8 <= h2fData when chanAddr = "0001000" and h2fValid = '1' else "00000000";
+	dina8 <= wrData when chanAddr = "0001000" and wrValid = '1' else "00000000";
 	--dinb8 <= h2fData;
-	dina9 <= h2fData when chanAddr = "0001001" and h2fValid = '1' else "00000000";
+	dina9 <= wrData when chanAddr = "0001001" and wrValid = '1' else "00000000";
 	--dinb9 <= h2fData;
 	-------------------data always sent to din , but written only when en=1
-	dina11 <= h2fData when chanAddr = "0010001" and h2fValid = '1' else "00000000";
+	dina11 <= wrData when chanAddr = "0010001" and wrValid = '1' else "00000000";
 	--dinb11 <= h2fData;
-	dina12 <= h2fData when chanAddr = "0010010" and h2fValid = '1' else "00000000";
+	dina12 <= wrData when chanAddr = "0010010" and wrValid = '1' else "00000000";
 	--dinb12 <= h2fData;
-	dina13 <= h2fData when chanAddr = "0010011" and h2fValid = '1' else "00000000";
+	dina13 <= wrData when chanAddr = "0010011" and wrValid = '1' else "00000000";
 	--dinb13 <= h2fData;
-	dina14 <= h2fData when chanAddr = "0010100" and h2fValid = '1' else "00000000";
+	dina14 <= wrData when chanAddr = "0010100" and wrValid = '1' else "00000000";
 	--dinb14 <= h2fData;
-	dina15 <= h2fData when chanAddr = "0010101" and h2fValid = '1' else "00000000";
+	dina15 <= wrData when chanAddr = "0010101" and wrValid = '1' else "00000000";
 	--dinb15 <= h2fData;
-	dina16 <= h2fData when chanAddr = "0010110" and h2fValid = '1' else "00000000";
+	dina16 <= wrData when chanAddr = "0010110" and wrValid = '1' else "00000000";
 	--dinb16 <= h2fData;
-	dina17 <= h2fData when chanAddr = "0010111" and h2fValid = '1' else "00000000";
+	dina17 <= wrData when chanAddr = "0010111" and wrValid = '1' else "00000000";
 	--dinb17 <= h2fData;
-	dina18 <= h2fData when chanAddr = "0011000" and h2fValid = '1' else "00000000";
+	dina18 <= wrData when chanAddr = "0011000" and wrValid = '1' else "00000000";
 	--dinb18 <= h2fData;
-	dina19 <= h2fData when chanAddr = "0011001" and h2fValid = '1' else "00000000";
+	dina19 <= wrData when chanAddr = "0011001" and wrValid = '1' else "00000000";
 	--dinb19 <= h2fData;
 	----------------data always sent to din , but written only when en=1
-	dina21 <= h2fData when chanAddr = "0100001" and h2fValid = '1' else "00000000";
+	dina21 <= wrData when chanAddr = "0100001" and wrValid = '1' else "00000000";
 	--dinb21 <= h2fData;
-	dina22 <= h2fData when chanAddr = "0100010" and h2fValid = '1' else "00000000";
+	dina22 <= wrData when chanAddr = "0100010" and wrValid = '1' else "00000000";
 	--dinb22 <= h2fData;
-	dina23 <= h2fData when chanAddr = "0100011" and h2fValid = '1' else "00000000";
+	dina23 <= wrData when chanAddr = "0100011" and wrValid = '1' else "00000000";
 	--dinb23 <= h2fData;
-	dina24 <= h2fData when chanAddr = "0100100" and h2fValid = '1' else "00000000";
+	dina24 <= wrData when chanAddr = "0100100" and wrValid = '1' else "00000000";
 	--dinb24 <= h2fData;
-	dina25 <= h2fData when chanAddr = "0100101" and h2fValid = '1' else "00000000";
+	dina25 <= wrData when chanAddr = "0100101" and wrValid = '1' else "00000000";
 	--dinb25 <= h2fData;
-	dina26 <= h2fData when chanAddr = "0100110" and h2fValid = '1' else "00000000";
+	dina26 <= wrData when chanAddr = "0100110" and wrValid = '1' else "00000000";
 	--dinb26 <= h2fData;
-	dina27 <= h2fData when chanAddr = "0100111" and h2fValid = '1' else "00000000";
+	dina27 <= wrData when chanAddr = "0100111" and wrValid = '1' else "00000000";
 	--dinb27 <= h2fData;
-	dina28 <= h2fData when chanAddr = "0101000" and h2fValid = '1' else "00000000";
+	dina28 <= wrData when chanAddr = "0101000" and wrValid = '1' else "00000000";
 	--dinb28 <= h2fData;
-	dina29 <= h2fData when chanAddr = "0101001" and h2fValid = '1' else "00000000";
+	dina29 <= wrData when chanAddr = "0101001" and wrValid = '1' else "00000000";
 	--dinb29 <= h2fData;
 	
-	process(chanAddr)
-	begin
-		if( chanAddr = "0010000") then
-			for i in 0 to 255 loop
-				for j in 0 to 255 loop
-					if((i=0 or i=255) and j mod 3=0) then
-						dina31 <= (doutb1);
-						addrb1 <= addrb1 + "0000000000001";
-						addra31 <=addra31 + "0000000000001";
-						dina32 <= (doutb11);
-						addrb11 <= addrb11 + "0000000000001";
-						addra32 <=addra32 + "0000000000001";
-						dina33 <= (doutb21);
-						addrb21 <= addrb21 + "0000000000001";
-						addra33 <=addra33 + "0000000000001";
-					elsif((i=0 or i=255) and j mod 3=1) then
-						dina31 <= (doutb4);
-						addrb4 <= addrb4 + "0000000000001";
-						addra31 <=addra31 + "0000000000001";
-						dina32 <= (doutb14);
-						addrb14 <= addrb14 + "0000000000001";
-						addra32 <=addra32 + "0000000000001";
-						dina33 <= (doutb24);
-						addrb24 <= addrb24 + "0000000000001";
-						addra33 <=addra33 + "0000000000001";
-					elsif((i=0 or i=255) and j mod 3=2) then
-						dina31 <= (doutb7);
-						addrb7 <= addrb7 + "0000000000001";
-						addra31 <=addra31 + "0000000000001";
-						dina32 <= (doutb17);
-						addrb17 <= addrb17 + "0000000000001";
-						addra32 <=addra32 + "0000000000001";
-						dina33 <= (doutb27);
-						addrb27 <= addrb27 + "0000000000001";
-						addra33 <=addra33 + "0000000000001";
-					elsif((j=0 or j=255) and i mod 3=0) then
-						dina31 <= (doutb1);
-						addrb1 <= addrb1 + "0000000000001";
-						addra31 <=addra31 + "0000000000001";
-						dina32 <= (doutb11);
-						addrb11 <= addrb11 + "0000000000001";
-						addra32 <=addra32 + "0000000000001";
-						dina33 <= (doutb21);
-						addrb21 <= addrb21 + "0000000000001";
-						addra33 <=addra33 + "0000000000001";
-					elsif((j=0 or j=255) and i mod 3=1) then
-						dina31 <= (doutb2);
-						addrb2 <= addrb2 + "0000000000001";
-						addra31 <=addra31 + "0000000000001";
-						dina32 <= (doutb12);
-						addrb12 <= addrb12 + "0000000000001";
-						addra32 <=addra32 + "0000000000001";
-						dina33 <= (doutb22);
-						addrb22 <= addrb22 + "0000000000001";
-						addra33 <=addra33 + "0000000000001";
-					elsif((j=0 or j=255) and i mod 3=2) then
-						dina31 <= (doutb3);
-						addrb3 <= addrb3 + "0000000000001";
-						addra31 <=addra31 + "0000000000001";
-						dina32 <= (doutb13);
-						addrb13 <= addrb13 + "0000000000001";
-						addra32 <=addra32 + "0000000000001";
-						dina33 <= (doutb23);
-						addrb23 <= addrb23 + "0000000000001";
-						addra33 <=addra33 + "0000000000001";
-					elsif(j mod 3=1) then
-						dina31<= std_logic_vector(unsigned(doutb1)+unsigned(doutb2)+unsigned(doutb3)+unsigned(doutb4)+unsigned(doutb5)+unsigned(doutb6)+unsigned(doutb7)+unsigned(doutb8)+unsigned(doutb9)/9);
-						addrb1 <= addrb1 + "0000000000001";
-						addrb2 <= addrb2 + "0000000000001";
-						addrb3 <= addrb3 + "0000000000001";
-						addra31 <= addra31 + "0000000000001";
-					dina32<=std_logic_vector(unsigned(doutb11)+unsigned(doutb12)+unsigned(doutb13)+unsigned(doutb14)+unsigned(doutb15)+unsigned(doutb16)+unsigned(doutb17)+unsigned(doutb18)+unsigned(doutb19)/9);
-						addrb11 <= addrb11 + "0000000000001";
-						addrb12 <= addrb12 + "0000000000001";
-						addrb13 <= addrb13 + "0000000000001";
-						addra32 <= addra32 + "0000000000001";
-					dina33<=std_logic_vector(unsigned(doutb21)+unsigned(doutb22)+unsigned(doutb23)+unsigned(doutb24)+unsigned(doutb25)+unsigned(doutb26)+unsigned(doutb27)+unsigned(doutb28)+unsigned(doutb29)/9);
-						addrb21 <= addrb21 + "0000000000001";
-						addrb22 <= addrb22 + "0000000000001";
-						addrb23 <= addrb23 + "0000000000001";
-						addra33 <= addra33 + "0000000000001";
-					elsif(j mod 3=2) then
-						dina31<=std_logic_vector(unsigned(doutb1)+unsigned(doutb2)+unsigned(doutb3)+unsigned(doutb4)+unsigned(doutb5)+unsigned(doutb6)+unsigned(doutb7)+unsigned(doutb8)+unsigned(doutb9)/9);
-						addrb4 <= addrb4 + "0000000000001";
-						addrb5 <= addrb5 + "0000000000001";
-						addrb6 <= addrb6 + "0000000000001";
-						addra31 <= addra31 + "0000000000001";
-					dina32<=std_logic_vector(unsigned(doutb11)+unsigned(doutb12)+unsigned(doutb13)+unsigned(doutb14)+unsigned(doutb15)+unsigned(doutb16)+unsigned(doutb17)+unsigned(doutb18)+unsigned(doutb19)/9);
-						addrb14 <= addrb14 + "0000000000001";
-						addrb15 <= addrb15 + "0000000000001";
-						addrb16 <= addrb16 + "0000000000001";
-						addra32 <= addra32 + "0000000000001";
-					dina33<=std_logic_vector(unsigned(doutb21)+unsigned(doutb22)+unsigned(doutb23)+unsigned(doutb24)+unsigned(doutb25)+unsigned(doutb26)+unsigned(doutb27)+unsigned(doutb28)+unsigned(doutb29)/9);
-						addrb24 <= addrb24 + "0000000000001";
-						addrb25 <= addrb25 + "0000000000001";
-						addrb26 <= addrb26 + "0000000000001";
-						addra33 <= addra33 + "0000000000001";
-					elsif(j mod 3=0) then
-						dina31<=std_logic_vector(unsigned(doutb1)+unsigned(doutb2)+unsigned(doutb3)+unsigned(doutb4)+unsigned(doutb5)+unsigned(doutb6)+unsigned(doutb7)+unsigned(doutb8)+unsigned(doutb9)/9);
-						addrb7 <= addrb7 + "0000000000001";
-						addrb8 <= addrb8 + "0000000000001";
-						addrb9 <= addrb9 + "0000000000001";
-						addra31 <= addra31 + "0000000000001";
-					dina32<=std_logic_vector(unsigned(doutb11)+unsigned(doutb12)+unsigned(doutb13)+unsigned(doutb14)+unsigned(doutb15)+unsigned(doutb16)+unsigned(doutb17)+unsigned(doutb18)+unsigned(doutb19)/9);
-						addrb17 <= addrb17 + "0000000000001";
-						addrb18 <= addrb18 + "0000000000001";
-						addrb19 <= addrb19 + "0000000000001";
-						addra32 <= addra32 + "0000000000001";
-					dina33<=std_logic_vector(unsigned(doutb21)+unsigned(doutb22)+unsigned(doutb23)+unsigned(doutb24)+unsigned(doutb25)+unsigned(doutb26)+unsigned(doutb27)+unsigned(doutb28)+unsigned(doutb29)/9);
-						addrb27 <= addrb27 + "0000000000001";
-						addrb28 <= addrb28 + "0000000000001";
-						addrb29 <= addrb29 + "0000000000001";
-						addra33 <= addra33 + "0000000000001";
-					end if;
-				end loop;
-			if(i =0) then
-				addrb1 <= addrb1 + "0000000000001";
-				addrb11 <= addrb11 + "0000000000001";
-				addrb21 <= addrb21 + "0000000000001";
-				addrb4 <= addrb4 + "0000000000001";
-				addrb14 <= addrb14 + "0000000000001";
-				addrb24 <= addrb24 + "0000000000001";
-				addrb7 <= addrb7 + "0000000000001";
-				addrb17 <= addrb17 + "0000000000001";
-				addrb27 <= addrb27 + "0000000000001";
-			elsif(i mod 3 = 1) then
-				addrb1 <= addrb1 + "0000000000001";
-				addrb11 <= addrb11 + "0000000000001";
-				addrb21 <= addrb21 + "0000000000001";
-				addrb4 <= addrb4 + "0000000000001";
-				addrb14 <= addrb14 + "0000000000001";
-				addrb24 <= addrb24 + "0000000000001";
-				addrb7 <= addrb7 + "0000000000001";
-				addrb17 <= addrb17 + "0000000000001";
-				addrb27 <= addrb27 + "0000000000001";
-				addrb2 <= addrb2 - "0000001010101";
-				addrb12 <= addrb12 - "0000001010101";
-				addrb22 <= addrb22 - "0000001010101";
-				addrb5 <= addrb5 - "0000001010100";
-				addrb15 <= addrb15 - "0000001010100";
-				addrb25 <= addrb25 - "0000001010100";
-				addrb8 <= addrb8 - "0000001010100";
-				addrb18 <= addrb18 - "0000001010100";
-				addrb28 <= addrb28 - "0000001010100";
-				addrb3 <= addrb3 - "0000001010101";
-				addrb13 <= addrb13 - "0000001010101";
-				addrb23 <= addrb23 - "0000001010101";
-				addrb6 <= addrb6 - "0000001010100";
-				addrb16 <= addrb16 - "0000001010100";
-				addrb26 <= addrb26 - "0000001010100";
-				addrb9 <= addrb9 - "0000001010100";
-				addrb19 <= addrb19 - "0000001010100";
-				addrb29 <= addrb29 - "0000001010100";
-			elsif(i mod 3 = 2) then
-				addrb2 <= addrb2 + "0000000000001";
-				addrb12 <= addrb12 + "0000000000001";
-				addrb22 <= addrb22 + "0000000000001";
-				addrb5 <= addrb5 + "0000000000001";
-				addrb15 <= addrb15 + "0000000000001";
-				addrb25 <= addrb25 + "0000000000001";
-				addrb8 <= addrb8 + "0000000000001";
-				addrb18 <= addrb18 + "0000000000001";
-				addrb28 <= addrb28 + "0000000000001";
-				addrb1 <= addrb1 - "0000001010101";
-				addrb11 <= addrb11 - "0000001010101";
-				addrb21 <= addrb21 - "0000001010101";
-				addrb4 <= addrb4 - "0000001010100";
-				addrb14 <= addrb14 - "0000001010100";
-				addrb24 <= addrb24 - "0000001010100";
-				addrb7 <= addrb7 - "0000001010100";
-				addrb17 <= addrb17 - "0000001010100";
-				addrb27 <= addrb27 - "0000001010100";
-				addrb3 <= addrb3 - "0000001010101";
-				addrb13 <= addrb13 - "0000001010101";
-				addrb23 <= addrb23 - "0000001010101";
-				addrb6 <= addrb6 - "0000001010100";
-				addrb16 <= addrb16 - "0000001010100";
-				addrb26 <= addrb26 - "0000001010100";
-				addrb9 <= addrb9 - "0000001010100";
-				addrb19 <= addrb19 - "0000001010100";
-				addrb29 <= addrb29 - "0000001010100";
-			elsif(i mod 3 = 0) then
-				addrb3 <= addrb3 + "0000000000001";
-				addrb13 <= addrb13 + "0000000000001";
-				addrb23 <= addrb23 + "0000000000001";
-				addrb6 <= addrb6 + "0000000000001";
-				addrb16 <= addrb16 + "0000000000001";
-				addrb26 <= addrb26 + "0000000000001";
-				addrb9 <= addrb9 + "0000000000001";
-				addrb19 <= addrb19 + "0000000000001";
-				addrb29 <= addrb29 + "0000000000001";
-				addrb1 <= addrb1 - "0000001010101";
-				addrb11 <= addrb11 - "0000001010101";
-				addrb21 <= addrb21 - "0000001010101";
-				addrb4 <= addrb4 - "0000001010100";
-				addrb14 <= addrb14 - "0000001010100";
-				addrb24 <= addrb24 - "0000001010100";
-				addrb7 <= addrb7 - "0000001010100";
-				addrb17 <= addrb17 - "0000001010100";
-				addrb27 <= addrb27 - "0000001010100";
-				addrb2 <= addrb2 - "0000001010101";
-				addrb12 <= addrb12 - "0000001010101";
-				addrb22 <= addrb22 - "0000001010101";
-				addrb5 <= addrb5 - "0000001010100";
-				addrb15 <= addrb15 - "0000001010100";
-				addrb25 <= addrb25 - "0000001010100";
-				addrb8 <= addrb8 - "0000001010100";
-				addrb18 <= addrb18 - "0000001010100";
-				addrb28 <= addrb28 - "0000001010100";
-			end if;
-			
-			end loop;	
-		end if;
-	end process;	
+	-- the pixel of the filter on doutb: a border one from its own BRAM,
+	-- the others the sum of the nine neighbours divided by 9
+	with fSelB select fBorder31 <=
+		doutb1				when 1,
+		doutb2				when 2,
+		doutb3				when 3,
+		doutb4				when 4,
+		doutb5				when 5,
+		doutb6				when 6,
+		doutb7				when 7,
+		doutb8				when 8,
+		doutb9				when others;
+	with fSelB select fBorder32 <=
+		doutb11				when 1,
+		doutb12				when 2,
+		doutb13				when 3,
+		doutb14				when 4,
+		doutb15				when 5,
+		doutb16				when 6,
+		doutb17				when 7,
+		doutb18				when 8,
+		doutb19				when others;
+	with fSelB select fBorder33 <=
+		doutb21				when 1,
+		doutb22				when 2,
+		doutb23				when 3,
+		doutb24				when 4,
+		doutb25				when 5,
+		doutb26				when 6,
+		doutb27				when 7,
+		doutb28				when 8,
+		doutb29				when others;
+	fSum31 <= resize(unsigned(doutb1),12)+resize(unsigned(doutb2),12)+resize(unsigned(doutb3),12)+resize(unsigned(doutb4),12)+resize(unsigned(doutb5),12)+resize(unsigned(doutb6),12)+resize(unsigned(doutb7),12)+resize(unsigned(doutb8),12)+resize(unsigned(doutb9),12);
+	fSum32 <= resize(unsigned(doutb11),12)+resize(unsigned(doutb12),12)+resize(unsigned(doutb13),12)+resize(unsigned(doutb14),12)+resize(unsigned(doutb15),12)+resize(unsigned(doutb16),12)+resize(unsigned(doutb17),12)+resize(unsigned(doutb18),12)+resize(unsigned(doutb19),12);
+	fSum33 <= resize(unsigned(doutb21),12)+resize(unsigned(doutb22),12)+resize(unsigned(doutb23),12)+resize(unsigned(doutb24),12)+resize(unsigned(doutb25),12)+resize(unsigned(doutb26),12)+resize(unsigned(doutb27),12)+resize(unsigned(doutb28),12)+resize(unsigned(doutb29),12);
+	dina31 <= fBorder31 when fEdgeB = '1' else std_logic_vector(resize(fSum31/9,8));
+	dina32 <= fBorder32 when fEdgeB = '1' else std_logic_vector(resize(fSum32/9,8));
+	dina33 <= fBorder33 when fEdgeB = '1' else std_logic_vector(resize(fSum33/9,8));
 	-- Select values to return for each channel when the host is reading
+	with idIndex select idByte <=
+		x"4C"	when "00",
+		x"50"	when "01",
+		x"32"	when "10",
+		x"37"	when others;
 	with chanAddr select f2hData <=
 		slide_sw_in 	when "0000000", -- return status of slide switches when reading R0
 		doutb1				when "0000001",
@@ -1577,11 +1774,29 @@ bram33 : calculated
 		douta31				when "0110001",
 		douta32				when "0110010",
 		douta33				when "0110011",
+		std_logic_vector(to_unsigned(lastCol,8))	when "0001011",
+		std_logic_vector(to_unsigned(lastRow,8))	when "0001100",
+		"000000" & not banked & bank	when "0001110",
+		idByte				when "1111111",
 		x"00" 			when others;
 ---------------------------------------------------------------------------------------------------
-	-- Assert that there's always data for reading, and always room for writing
-	f2hValid <= '1';
-	h2fReady <= '1';								--END_SNIPPET(registers)
+	fBusy <= fRun or fFeed or fData;
+	fHold <= '1' when fBusy = '1' and (chanAddr = "0000000" or chanAddr = "0001011"
+		or chanAddr = "0001100" or chanAddr = "0001110" or chanAddr = "0010000"
+		or chanAddr(6 downto 4) = "011" or (banked = '0' and isPhase(chanAddr))) else '0';
+
+	-- decoded byte: previous one plus the difference from the host or of the run
+	zData <= zPrev + zDelta when zState = Z_REPEAT else zPrev + h2fData;
+	zValid <= '1' when zState = Z_REPEAT or ((zState = Z_LIT or zState = Z_RUN) and h2fValid = '1') else '0';
+	wrValid <= zValid when zMode = '1' else h2fValid;
+	wrData <= zData when zMode = '1' else h2fData;
+
+	-- Assert that there's always data for reading, and room for writing
+	-- except while the decoder writes out a run. While the filter runs the
+	-- host waits on fHold, and on reads of the phase BRAMs whose port b the
+	-- filter has
+	f2hValid <= '0' when fHold = '1' or (fBusy = '1' and isPhase(chanAddr)) else '1';
+	h2fReady <= '0' when fHold = '1' or (zMode = '1' and zState = Z_REPEAT) else '1';								--END_SNIPPET(registers)
 
 	-- CommFPGA module
 	fx2Read_out <= fx2Read;
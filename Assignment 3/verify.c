@@ -0,0 +1,136 @@
+#include <string.h>
+#include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "verify.h"
+
+/* count differing bytes of a and b, raise heat and *maxe to |a-b| */
+static long compare_row(const unsigned char *a, const unsigned char *b, unsigned char *heat, int n, int *maxe)
+{
+	long count = 0;
+	int j = 0;
+#ifdef __SSE2__
+	const __m128i z = _mm_setzero_si128();
+	__m128i mx = z;
+	unsigned char lanes[16];
+	int l;
+	for(;j+16<=n;j+=16){
+		__m128i x = _mm_loadu_si128((const __m128i *)(a+j));
+		__m128i y = _mm_loadu_si128((const __m128i *)(b+j));
+		__m128i d = _mm_or_si128(_mm_subs_epu8(x,y), _mm_subs_epu8(y,x));
+		__m128i h = _mm_loadu_si128((const __m128i *)(heat+j));
+		_mm_storeu_si128((__m128i *)(heat+j), _mm_max_epu8(h,d));
+		mx = _mm_max_epu8(mx,d);
+		count += __builtin_popcount(~_mm_movemask_epi8(_mm_cmpeq_epi8(d,z)) & 0xffff);
+	}
+	_mm_storeu_si128((__m128i *)lanes, mx);
+	for(l=0;l<16;l++)
+		if(lanes[l] > *maxe) *maxe = lanes[l];
+#endif
+	for(;j<n;j++){
+		int d = a[j] > b[j] ? a[j] - b[j] : b[j] - a[j];
+		if(d){
+			count++;
+			if(d > heat[j]) heat[j] = (unsigned char)d;
+			if(d > *maxe) *maxe = d;
+		}
+	}
+	return count;
+}
+
+long verify_lowpass(const IMAGE *input, const IMAGE *result, const ROI *roi, VERIFY_REPORT *rep)
+{
+	int H = input->H, W = input->W, k, i;
+	size_t n = (size_t)H * W;
+	unsigned char *golden = (unsigned char *)malloc(n);
+	long total = 0;
+
+	memset(rep, 0, sizeof(*rep));
+	rep->H = H;
+	rep->W = W;
+	rep->heat = (unsigned char *)calloc(n, 1);
+	if(golden==NULL || rep->heat==NULL){
+		free(golden);
+		verify_free(rep);
+		return -1;
+	}
+
+	for(k=0;k<NUM_PLANES;k++){
+		long count = 0;
+		int maxe = 0;
+
+		if(input->plane[k]==NULL)
+			continue;
+		rep->planes |= 1 << k;
+		memcpy(golden, input->plane[k], n);
+		lowpass_plane(input->plane[k], golden, H, W, roi);
+
+		#pragma omp parallel for schedule(static) reduction(+:count) reduction(max:maxe)
+		for(i=0;i<H;i++){
+			size_t o = (size_t)i * W;
+			int m = 0;
+			count += compare_row(golden + o, result->plane[k] + o, rep->heat + o, W, &m);
+			if(m > maxe) maxe = m;
+		}
+		rep->mismatches[k] = count;
+		rep->max_err[k] = maxe;
+		total += count;
+	}
+	free(golden);
+	return total;
+}
+
+void verify_print(const VERIFY_REPORT *rep, FILE *f)
+{
+	static const char *name[NUM_PLANES] = { "blue", "green", "red" };
+	long n = (long)rep->H * rep->W;
+	int k;
+
+	fprintf(f, "\nVerification against the software low-pass, %d x %d\n", rep->H, rep->W);
+	for(k=0;k<NUM_PLANES;k++)
+		if(!(rep->planes & (1 << k)))
+			fprintf(f, "%-6s not requested\n", name[k]);
+		else
+			fprintf(f, "%-6s %8ld of %ld pixels differ (%.2f%%), max error %d\n", name[k],
+				rep->mismatches[k], n, n ? 100.0 * rep->mismatches[k] / n : 0.0, rep->max_err[k]);
+	if(rep->mismatches[0] + rep->mismatches[1] + rep->mismatches[2] == 0)
+		fprintf(f, "PASS: bit exact\n");
+	else
+		fprintf(f, "FAIL\n");
+}
+
+int verify_write_heatmap(const VERIFY_REPORT *rep, const BMP *bmp, const char *filename)
+{
+	int Wp = BMP_ROW_BYTES(rep->W), i, j, maxe = 1, k;
+	unsigned char *RGB = (unsigned char *)calloc((size_t)Wp * rep->H, 1);
+	FILE *f;
+
+	for(k=0;k<NUM_PLANES;k++)
+		if(rep->max_err[k] > maxe) maxe = rep->max_err[k];
+	f = fopen(filename, "wb");
+	if(f==NULL || RGB==NULL){
+		if(f) fclose(f);
+		free(RGB);
+		return 0;
+	}
+	for(i=0;i<rep->H;i++)
+		for(j=0;j<rep->W;j++){
+			unsigned char v = (unsigned char)(rep->heat[(size_t)i * rep->W + j] * 255 / maxe);
+			RGB[(size_t)i * Wp + 3*j] = RGB[(size_t)i * Wp + 3*j + 1] = RGB[(size_t)i * Wp + 3*j + 2] = v;
+		}
+	fwrite(&bmp->bType, sizeof(unsigned short), 1, f);
+	fwrite((const int *)bmp + 1, sizeof(BMP) - 4, 1, f);
+	fseek(f, bmp->bOffBits, SEEK_SET);
+	fwrite(RGB, 1, (size_t)Wp * rep->H, f);
+	fclose(f);
+	free(RGB);
+	return 1;
+}
+
+void verify_free(VERIFY_REPORT *rep)
+{
+	free(rep->heat);
+	rep->heat = NULL;
+}
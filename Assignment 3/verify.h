@@ -0,0 +1,30 @@
+/* Bit-exact check of a low-pass result against the software model.
+ * The golden image is box_filter.c applied to the same input: border
+ * pixels and pixels outside the region copied, the rest the truncated
+ * sum / 9, which is what the fabric computes.
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdio.h>
+#include "image.h"
+#include "box_filter.h"
+
+typedef struct VERIFY_REPORT{
+	int H, W;
+	int planes;                     /* mask of the planes compared */
+	long mismatches[NUM_PLANES];    /* pixels that differ, per plane */
+	int max_err[NUM_PLANES];        /* largest absolute difference, per plane */
+	unsigned char *heat;            /* H x W, largest difference over the planes */
+}VERIFY_REPORT;
+
+/* returns the total number of mismatching pixel values, -1 without memory.
+ * NULL planes of input are not compared */
+long verify_lowpass(const IMAGE *input, const IMAGE *result, const ROI *roi, VERIFY_REPORT *rep);
+void verify_print(const VERIFY_REPORT *rep, FILE *f);
+/* write the heat map as a grey BMP, the largest error is white */
+int verify_write_heatmap(const VERIFY_REPORT *rep, const BMP *bmp, const char *filename);
+void verify_free(VERIFY_REPORT *rep);
+
+#endif
@@ -342,6 +342,11 @@ architecture behavioural of matrix_multiplier is
 	
 	-- Registers implementing the channels
 	signal reg0, reg0_next         : std_logic_vector(7 downto 0)  := x"00";
+
+	-- Design identity, read from channel 127 as the four bytes "MM16". The
+	-- host checks it and skips loading the bitstream when it matches.
+	signal idIndex :std_logic_vector(1 downto 0) :="00";
+	signal idByte  :std_logic_vector(7 downto 0);
 	--enable computing C
 	signal multiply_en                     : std_logic  :='0';
 	
@@ -844,6 +849,12 @@ begin													-- BEGIN_SNIPPET(registers)
 	begin
 		if ( rising_edge(fx2Clk_in) ) then
 			reg0 <= reg0_next;
+			--next identity byte per read, from the first when selected again
+			if(chanAddr = "1111111" and f2hReady = '1') then
+				idIndex <= idIndex + "01";
+			elsif(chanAddr /= "1111111") then
+				idIndex <= "00";
+			end if;
 			--FSM 3 states 00 01 02(in hex).
 			if( reg0 = x"00") then
 				--read A and B
@@ -993,9 +1004,16 @@ begin													-- BEGIN_SNIPPET(registers)
 	dina17 <= h2fData when chanAddr = "0010111" and h2fValid = '1' else "00000000";
 	
 	-- Select values to return for each channel when the host is reading
+	with idIndex select idByte <=
+		x"4D"	when "00",
+		x"4D"	when "01",
+		x"31"	when "10",
+		x"36"	when others;
+
 	with chanAddr select f2hData <=
 		reg0 	when "0000000",
 		douta18 when "0011000",
+		idByte	when "1111111",
 		x"00" 			when others;
 	
 	--DO NOT CHANGE ANYTHING BELOW
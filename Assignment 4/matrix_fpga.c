@@ -0,0 +1,47 @@
+#include "matrix_fpga.h"
+
+int matrix_fpga_multiply(FPGA *f,const unsigned char A[MATRIX_N][MATRIX_N],
+	const unsigned char B[MATRIX_N][MATRIX_N],unsigned short C[MATRIX_N][MATRIX_N]){
+	unsigned char col[MATRIX_N*MATRIX_N],cmd[2],hex=0x00;
+	int i,j;
+
+//rows of A, then B column-wise
+	fpga_phase(f,FPGA_PHASE_UPLOAD);
+	cmd[0]=0x00;
+	if(!fpga_write(f,0x00,cmd,1))
+		return 0;
+	for(i=0;i<MATRIX_N;i++)
+		if(!fpga_write(f,i+1,A[i],MATRIX_N))
+			return 0;
+	for(i=0;i<MATRIX_N;i++)
+		for(j=0;j<MATRIX_N;j++)
+			col[MATRIX_N*i+j]=B[j][i];
+	if(!fpga_write(f,0x11,col,sizeof(col)))
+		return 0;
+	fpga_phase(f,FPGA_PHASE_COMPUTE);
+	cmd[0]=0x01; cmd[1]=0x02;
+	if(!fpga_write(f,0x00,cmd,2))
+		return 0;
+
+//Checking if C is computed
+	for(i=0;hex!=0x03;i++){
+		if(i==MATRIX_POLL_LIMIT){
+			f->error="C was not computed";
+			return 0;
+		}
+		if(!fpga_read(f,0x00,&hex,1))
+			return 0;
+	}
+//Read C, row i from channel i+18
+	fpga_phase(f,FPGA_PHASE_READBACK);
+	for(i=0;i<MATRIX_N;i++){
+		unsigned char hex_ar[MATRIX_N+1];
+		cmd[0]=0x01; cmd[1]=0x03;
+		if(!fpga_write(f,0x00,cmd,2) || !fpga_read(f,i+18,hex_ar,MATRIX_N+1))
+			return 0;
+		//skip the first read value
+		for(j=0;j<MATRIX_N;j++)
+			C[i][j]=(unsigned short)hex_ar[j+1];
+	}
+	return 1;
+}
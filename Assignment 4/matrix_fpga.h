@@ -0,0 +1,19 @@
+//16x16 product of Matrix_Multiplier.vhdl over an open FPGA, shared by
+//matrix_multiplication_fpga.c and the job daemon of Assignment 3.
+//Row i of A goes to channel i+1, B column-wise to channel 0x11, writing
+//01 02 to channel 0 starts the product and channel 0 reads 03 when it is
+//done. Row i of C then comes from channel i+18 after one stale byte.
+#ifndef MATRIX_FPGA_H
+#define MATRIX_FPGA_H
+
+#include "../Assignment 3/fpga_transport.h"
+
+#define MATRIX_N 16
+#define MATRIX_POLL_LIMIT 100000	//reads of the status register before giving up
+#define MATRIX_DESIGN_ID "MM16"	//identity of Matrix_Multiplier on FPGA_ID_CHAN
+
+//returns 1 with C filled, else 0 with f->error set
+int matrix_fpga_multiply(FPGA *f,const unsigned char A[MATRIX_N][MATRIX_N],
+	const unsigned char B[MATRIX_N][MATRIX_N],unsigned short C[MATRIX_N][MATRIX_N]);
+
+#endif
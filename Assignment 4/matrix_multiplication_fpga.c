@@ -1,5 +1,12 @@
+/* gcc -O2 -DFPGALINK matrix_multiplication_fpga.c matrix_fpga.c "../Assignment 3/fpga_transport.c" "../Assignment 3/fpga_daemon_client.c" "../Assignment 3/fpga_replay.c" "../Assignment 3/hexcodec.c" "../Assignment 3/result_cache.c" -lfpgalink -o matrix_fpga */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "../Assignment 3/fpga_transport.h"
+#include "../Assignment 3/fpga_daemon.h"
+#include "../Assignment 3/result_cache.h"
+#include "matrix_fpga.h"
 
 //this function prints the values of matrix,each row on a new line
 void printMatrix(unsigned short A[16][16]){
@@ -12,103 +19,111 @@ void printMatrix(unsigned short A[16][16]){
 	}
 }
 
-void main(){
-	unsigned short matrix_element,B[16][16]; 					//declaring temporary variable for matrix element for A and matrixB
+//exits with the transport error if a transfer failed
+void check(FPGA *fpga,int ok,const char *what){
+	if(!ok){
+		printf("%s: %s\n",what,fpga->error);
+		fpga_close(fpga);
+		exit(1);
+	}
+}
+
+int main(int argc,char **argv){
+	unsigned short matrix_element,C[16][16]; 					//declaring temporary variable for matrix element and the product
+	unsigned char A[16][16],B[16][16];
 	FILE *fp = fopen("matrix_data.txt","r"); 		//opening file which contains data for the 2 matrices
 	int i=0,j=0;									//initialising general purpose variables i and j
-	FILE *wrt = fopen("writeToBram.sh","w");
+	const char *backend = fpga_default_backend();
+	const char *stats = NULL;		//transfer statistics go there as JSON
+	const char *daemon = NULL;		//socket of fpga_daemon, NULL to open the board here
+	const char *cache_dir = NULL;		//products of matrices seen before, NULL for none
+	char error[DAEMON_ERROR_LEN];
+	RESULT_CACHE cache;
+	RESULT_KEY key;
+	FPGA fpga;
 
-//reading data for matrix A	
-	fprintf(wrt,"cd C:/makestuff/libs/libfpgalink-20120621\n");
-	fprintf(wrt,"./win32/rel/flcli -v 1443:0007 -a \"w0 00;");
-	int count=0;	//stores the channel number to which data is to be written
-	for(i=0;i<16;i++){
-		count++;
-		fputs("w",wrt);
-		fprintf(wrt,"%02X",count);
-		fputs(" ",wrt);
-		for(j=0;j<16;j++){
-			fscanf(fp,"%hu",&matrix_element);
-			fprintf(wrt,"%02X",matrix_element);
-		}
-		fputs(";",wrt);
+	for(i=1;i+1<argc;i+=2){
+		if(strcmp(argv[i],"-B")==0)
+			backend = argv[i+1];
+		else if(strcmp(argv[i],"-J")==0)
+			stats = argv[i+1];
+		else if(strcmp(argv[i],"-D")==0)
+			daemon = argv[i+1];
+		else if(strcmp(argv[i],"-C")==0)
+			cache_dir = argv[i+1];
 	}
-//reading data for matrix B 
-	count++;
-	fputs("w",wrt);
-	fprintf(wrt,"%02X",count);
-	fputs(" ",wrt);
-	for(i=0;i<16;i++){
+
+	if(fp==NULL){
+		puts("Cannot open matrix_data.txt");
+		return 1;
+	}
+//reading data for matrix A and B
+	for(i=0;i<16;i++)
 		for(j=0;j<16;j++){
-			fscanf(fp,"%hu",&B[i][j]);
+			fscanf(fp,"%hu",&matrix_element);
+			A[i][j]=(unsigned char)matrix_element;
 		}
-	}
-//sending matrix B column-wise
-	for(i=0;i<16;i++){
+	for(i=0;i<16;i++)
 		for(j=0;j<16;j++){
-			fprintf(wrt,"%02X",B[j][i]);
+			fscanf(fp,"%hu",&matrix_element);
+			B[i][j]=(unsigned char)matrix_element;
 		}
-	}
-	fprintf(wrt,";w0 0102\"");
-	fclose(wrt);
 	fclose(fp);
 
-//------Reading A and B Complete--------//
-
-//writing A and B to BRAMs
-	char cmd[]="sh fpga-link_init.sh";
-	system(cmd);
-	char cmd1[]="sh writeToBram.sh";
-	system(cmd1);
+//the same A and B were multiplied before, the board is not needed
+	if(cache_dir!=NULL){
+		result_cache_init(&cache,RESULT_CACHE_MEM,cache_dir);
+		result_key_init(&key,RESULT_MATRIX,NULL,0);
+		result_key_add(&key,A,sizeof(A));
+		result_key_add(&key,B,sizeof(B));
+		if(result_cache_get(&cache,&key,C,sizeof(C))){
+			result_cache_free(&cache);
+			printf("Matrix C (from the cache):\n");
+			printMatrix(C);
+			return 0;
+		}
+	}
 
-//Checking if C is computed
-	unsigned short C[16][16];
+	if(daemon!=NULL){
+//the daemon owns the board, only the matrices go over its socket
+		if(!daemon_matrix(daemon,A,B,C,error)){
+			printf("%s\n",error);
+			return 1;
+		}
+		if(cache_dir!=NULL){
+			result_cache_put(&cache,&key,C,sizeof(C));
+			result_cache_free(&cache);
+		}
+		printf("Matrix C:\n");
+		printMatrix(C);
+		return 0;
+	}
 
-	FILE *dc = fopen("dataComputed.sh","w");
-	fprintf(dc,"./C:/makestuff/libs/libfpgalink-20120621/win32/rel/flcli -v 1443:0007 -a \"r0 1 \\\"reg0.txt\\\"\"");
-	
-	char cmd2[]="sh dataComputed.sh";
+//the device is opened in-process, flcli loads the design only when the board does not have it yet
+	switch(fpga_open_design(&fpga,backend,NULL,MATRIX_DESIGN_ID,strcmp(backend,"loopback")!=0 ? "sh fpga-link_init.sh" : NULL)){
+	case 0:
+		printf("Cannot open the FPGA: %s\n",fpga.error);
+		return 1;
+	case 2:
+		puts("loaded the design");
+	}
 
-	unsigned char hex = 0x00;
-    while(hex!=0x03){
-		system(cmd2);	
-    	FILE *fpr0 = fopen("reg0.txt","rb");
-   	 	fread ( &hex, 1,1, fpr0);
-   	 	fclose(fpr0);
-    }
-//Read C
-    for(i=0;i<16;i++){
-		FILE *cr = fopen("Cread.sh","w");
-		fprintf(cr,"./C:/makestuff/libs/libfpgalink-20120621/win32/rel/flcli -v 1443:0007 -a \"w0 0103;r%2X 11 \\\"matrix_c.txt\\\"\"",i+18);
-		fclose(cr);
-		char cmd3[]="sh Cread.sh";
-		system(cmd3);	
-	    
-	    FILE *fpc = fopen("matrix_c.txt","rb");
-		unsigned char hex_ar[17] = "";
-	   	fread (&hex_ar, 1,17, fpc);
-		//skip the first read value
-		for(j=0;j<16;j++){
-			C[i][j] = (unsigned short)(hex_ar[j+1]);	
+	check(&fpga,matrix_fpga_multiply(&fpga,A,B,C),"multiply");
+	if(stats!=NULL){
+		FILE *out = fopen(stats,"w");
+		if(out!=NULL){
+			fpga_stats_json(&fpga,1,out);
+			fclose(out);
 		}
 	}
-	/*
-	uint8 buf = 0x00;
-	struct FLContext *handle = NULL;
-	FLStatus status;
-	const char *error = NULL;
-	while(buf!=0x03){
-		status = flReadChannel(handle, 1000, 0x00, 1, &buf, &error);
-	}*/
-//Read C
-	/*for(i=0;i<16;i++){
-		for(j=0;j<16;j++){
-			status = flReadChannel(handle, 1000, 0x00, 1, &buf, &error);
-			C[i][j] = buf;		
-		}
-	}*/
+	fpga_close(&fpga);
+	if(cache_dir!=NULL){
+		result_cache_put(&cache,&key,C,sizeof(C));
+		result_cache_free(&cache);
+	}
 
 //printing C
 	 printf("Matrix C:\n");
 	 printMatrix(C);
-}
\ No newline at end of file
+	 return 0;
+}